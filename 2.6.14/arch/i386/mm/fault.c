@@ -240,6 +240,7 @@ fastcall void __kprobes do_page_fault(struct pt_regs *regs,
 	unsigned long address;
 	unsigned long page;
 	int write, si_code;
+	int fault_flags = FAULT_FLAG_ALLOW_RETRY;
 
 	/* get the address */
 	/*获取引起缺页的线性地址，它被保存在cr2寄存器*/
@@ -318,6 +319,7 @@ fastcall void __kprobes do_page_fault(struct pt_regs *regs,
 		down_read(&mm->mmap_sem);
 	}
 
+retry:
 	vma = find_vma(mm, address);
 	/*没有找到vma_end > address的线性区，说明地址越界到3G以上空间*/
 	if (!vma)
@@ -388,13 +390,27 @@ good_area:
 	 * 如果线性区的访问权限与引起异常的访问类型匹配，
 	 * 执行handle_mm_fault(请求调页)分配一个新的页框,如果成功则返回VM_FAULT_MINOR或VM_FAULT_MAJOR
 	 */
-	switch (handle_mm_fault(mm, vma, address, write)) {
+	switch (handle_mm_fault(mm, vma, address, write | fault_flags)) {
 		case VM_FAULT_MINOR:
-			tsk->min_flt++;
+			/* a retried fault was already counted as major */
+			if (fault_flags & FAULT_FLAG_ALLOW_RETRY)
+				tsk->min_flt++;
 			break;
 		case VM_FAULT_MAJOR:
-			tsk->maj_flt++;
+			if (fault_flags & FAULT_FLAG_ALLOW_RETRY)
+				tsk->maj_flt++;
 			break;
+		/*
+		 * mmap_sem was dropped while the page was read in.  Take it
+		 * again and redo the fault from the vma lookup, since the
+		 * address space may have changed meanwhile; only once, so
+		 * that we can't loop here forever.
+		 */
+		case VM_FAULT_RETRY:
+			tsk->maj_flt++;
+			fault_flags &= ~FAULT_FLAG_ALLOW_RETRY;
+			down_read(&mm->mmap_sem);
+			goto retry;
 		/*返回VM_FAULT_SIGBUS，向进程发送SIGBUS信号*/
 		case VM_FAULT_SIGBUS:
 			goto do_sigbus;
@@ -0,0 +1,194 @@
+/*
+ * linux/arch/i386/mm/gup.c
+ *
+ * Lockless get_user_pages_fast for i386.
+ *
+ * The page tables are walked with interrupts disabled: page table pages
+ * are only freed after a TLB flush IPI has been acknowledged by every
+ * CPU that might be using the mm, so they cannot go away under us while
+ * this CPU refuses to take the IPI.  Only pages that are already present
+ * with the right permissions are pinned here; anything else is left to
+ * the regular get_user_pages() under mmap_sem.
+ */
+
+#include <linux/config.h>
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/highmem.h>
+#include <asm/pgtable.h>
+#include <asm/uaccess.h>
+
+/*
+ * With PAE a pte is two words wide and cannot be read atomically.  Read
+ * the low word, then the high word, and retry if the low word changed
+ * meanwhile: the pte may only go from present to not-present under us,
+ * and that always clears the low word first.
+ */
+static inline pte_t gup_get_pte(pte_t *ptep)
+{
+#ifndef CONFIG_X86_PAE
+	return *ptep;
+#else
+	pte_t pte;
+
+retry:
+	pte.pte_low = ptep->pte_low;
+	smp_rmb();
+	pte.pte_high = ptep->pte_high;
+	smp_rmb();
+	if (unlikely(pte.pte_low != ptep->pte_low))
+		goto retry;
+
+	return pte;
+#endif
+}
+
+/*
+ * Returns 1 if every page in the range was pinned, 0 if the slow path
+ * has to take over from *nr onwards.
+ */
+static int gup_pte_range(pmd_t pmd, unsigned long addr, unsigned long end,
+			 int write, struct page **pages, int *nr)
+{
+	unsigned long mask = _PAGE_PRESENT | _PAGE_USER;
+	pte_t *ptep, *start;
+
+	if (write)
+		mask |= _PAGE_RW;
+
+	start = ptep = pte_offset_map(&pmd, addr);
+	do {
+		pte_t pte = gup_get_pte(ptep);
+		unsigned long pfn = pte_pfn(pte);
+		struct page *page;
+
+		if ((pte_val(pte) & mask) != mask || !pfn_valid(pfn)) {
+			pte_unmap(start);
+			return 0;
+		}
+		page = pfn_to_page(pfn);
+		if (PageReserved(page)) {
+			pte_unmap(start);
+			return 0;
+		}
+		get_page(page);
+		pages[*nr] = page;
+		(*nr)++;
+	} while (ptep++, addr += PAGE_SIZE, addr != end);
+	pte_unmap(start);
+
+	return 1;
+}
+
+static int gup_pmd_range(pud_t pud, unsigned long addr, unsigned long end,
+			 int write, struct page **pages, int *nr)
+{
+	unsigned long next;
+	pmd_t *pmdp;
+
+	pmdp = pmd_offset(&pud, addr);
+	do {
+		pmd_t pmd = *pmdp;
+
+		next = pmd_addr_end(addr, end);
+		/* large (hugetlb) pages are left to the slow path */
+		if (pmd_none(pmd) || (pmd_val(pmd) & _PAGE_PSE))
+			return 0;
+		if (!gup_pte_range(pmd, addr, next, write, pages, nr))
+			return 0;
+	} while (pmdp++, addr = next, addr != end);
+
+	return 1;
+}
+
+static int gup_pud_range(pgd_t pgd, unsigned long addr, unsigned long end,
+			 int write, struct page **pages, int *nr)
+{
+	unsigned long next;
+	pud_t *pudp;
+
+	pudp = pud_offset(&pgd, addr);
+	do {
+		pud_t pud = *pudp;
+
+		next = pud_addr_end(addr, end);
+		if (pud_none(pud))
+			return 0;
+		if (!gup_pmd_range(pud, addr, next, write, pages, nr))
+			return 0;
+	} while (pudp++, addr = next, addr != end);
+
+	return 1;
+}
+
+/**
+ * get_user_pages_fast() - pin user pages in memory without mmap_sem
+ * @start:	starting user address
+ * @nr_pages:	number of pages from start to pin
+ * @write:	whether pages will be written to
+ * @pages:	array that receives pointers to the pages pinned.
+ *
+ * Works on current->mm only.  Returns the number of pages pinned, which
+ * may be fewer than requested, or a negative errno if no pages could be
+ * pinned at all.  Pages must be released with page_cache_release().
+ */
+int get_user_pages_fast(unsigned long start, int nr_pages, int write,
+			struct page **pages)
+{
+	struct mm_struct *mm = current->mm;
+	unsigned long addr, len, end;
+	unsigned long next;
+	pgd_t *pgdp;
+	int nr = 0;
+
+	start &= PAGE_MASK;
+	addr = start;
+	len = (unsigned long)nr_pages << PAGE_SHIFT;
+	end = start + len;
+	if (unlikely(!access_ok(write ? VERIFY_WRITE : VERIFY_READ,
+				(void __user *)start, len)))
+		goto slow_irqon;
+
+	local_irq_disable();
+	pgdp = pgd_offset(mm, addr);
+	do {
+		pgd_t pgd = *pgdp;
+
+		next = pgd_addr_end(addr, end);
+		if (pgd_none(pgd))
+			goto slow;
+		if (!gup_pud_range(pgd, addr, next, write, pages, &nr))
+			goto slow;
+	} while (pgdp++, addr = next, addr != end);
+	local_irq_enable();
+
+	BUG_ON(nr != nr_pages);
+	return nr;
+
+slow:
+	local_irq_enable();
+slow_irqon:
+	{
+		int ret;
+
+		/* Try to get the remaining pages with get_user_pages */
+		start += nr << PAGE_SHIFT;
+		pages += nr;
+
+		down_read(&mm->mmap_sem);
+		ret = get_user_pages(current, mm, start,
+				     (end - start) >> PAGE_SHIFT, write, 0,
+				     pages, NULL);
+		up_read(&mm->mmap_sem);
+
+		/* Have to be a bit careful with return values */
+		if (nr > 0) {
+			if (ret < 0)
+				ret = nr;
+			else
+				ret += nr;
+		}
+
+		return ret;
+	}
+}
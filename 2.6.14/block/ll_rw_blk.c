@@ -1635,6 +1635,7 @@ void blk_cleanup_queue(request_queue_t * q)
 
 	blk_queue_ordered(q, QUEUE_ORDERED_NONE);
 
+	bdi_destroy(&q->backing_dev_info);
 	kmem_cache_free(requestq_cachep, q);
 }
 
@@ -1682,6 +1683,7 @@ request_queue_t *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 	/*初始化request_queue下的bdi的unplug回调*/
 	q->backing_dev_info.unplug_io_fn = blk_backing_dev_unplug;
 	q->backing_dev_info.unplug_io_data = q;
+	bdi_init(&q->backing_dev_info);
 
 	return q;
 }
@@ -1772,7 +1774,9 @@ blk_init_queue_node(request_fn_proc *rfn, spinlock_t *lock, int node_id)
 	}
 
 	blk_cleanup_queue(q);
+	return NULL;
 out_init:
+	bdi_destroy(&q->backing_dev_info);
 	kmem_cache_free(requestq_cachep, q);
 	return NULL;
 }
@@ -2129,6 +2133,129 @@ void blk_insert_request(request_queue_t *q, struct request *rq,
 
 EXPORT_SYMBOL(blk_insert_request);
 
+static int __blk_rq_unmap_user(struct bio *bio)
+{
+	int ret = 0;
+
+	if (bio) {
+		if (bio_flagged(bio, BIO_USER_MAPPED))
+			bio_unmap_user(bio);
+		else
+			ret = bio_uncopy_user(bio);
+	}
+
+	return ret;
+}
+
+/*
+ * Undo __blk_rq_map_user() for a bio that never went to the device.
+ * Nothing was transferred, so no bounced data may be copied back: the
+ * error given to bio_endio() keeps the highmem bounce from doing it.
+ */
+static void __blk_rq_discard_user(struct bio *bio)
+{
+	struct bio *orig_bio = bio;
+
+	if (bio_flagged(bio, BIO_BOUNCED)) {
+		orig_bio = bio->bi_private;
+		bio_endio(bio, bio->bi_size, -EIO);
+	}
+	if (bio_flagged(orig_bio, BIO_USER_MAPPED))
+		bio_unmap_user(orig_bio);
+	else
+		bio_discard_copy_user(orig_bio);
+	bio_put(bio);
+}
+
+/*
+ * Release the bio chain of a request whose mapping failed part way.
+ */
+static void blk_rq_discard_user(struct request *rq)
+{
+	struct bio *bio = rq->bio;
+
+	while (bio) {
+		struct bio *next = bio->bi_next;
+
+		__blk_rq_discard_user(bio);
+		bio = next;
+	}
+	rq->bio = rq->biotail = NULL;
+}
+
+/*
+ * Map at most one bio worth of user data at @ubuf and append it to @rq.
+ * Data whose address and length both meet the queue's dma alignment is
+ * pinned for direct dma.  Anything else is bounced through kernel pages,
+ * all of it in one bio: splitting off the misaligned part would leave a
+ * bio shorter than the alignment.  Returns the number of bytes mapped.
+ */
+static int __blk_rq_map_user(request_queue_t *q, struct request *rq,
+			     void __user *ubuf, unsigned int len)
+{
+	unsigned long uaddr = (unsigned long) ubuf;
+	unsigned int align = queue_dma_alignment(q);
+	unsigned int map_len;
+	struct bio *bio;
+	int reading, ret;
+
+	reading = rq_data_dir(rq) == READ;
+
+	if ((uaddr | len) & align) {
+		map_len = len;
+		bio = bio_copy_user(q, uaddr, map_len, reading);
+	} else {
+		map_len = min_t(unsigned int, len,
+				BIO_MAX_SIZE - offset_in_page(uaddr));
+		bio = bio_map_user(q, NULL, uaddr, map_len, reading);
+	}
+	if (IS_ERR(bio))
+		return PTR_ERR(bio);
+
+	/*
+	 * bounce here, keeping the original bio reachable through the
+	 * bounce bio's bi_private for blk_rq_unmap_user().  The extra
+	 * reference keeps the bounce bio alive after completion, as the
+	 * request chain is walked again at unmap time.
+	 */
+	blk_queue_bounce(q, &bio);
+	bio_get(bio);
+
+	if (!rq->bio)
+		blk_rq_bio_prep(q, rq, bio);
+	else if (!q->back_merge_fn(q, rq, bio)) {
+		ret = -EINVAL;
+		goto unmap_bio;
+	} else {
+		rq->biotail->bi_next = bio;
+		rq->biotail = bio;
+		rq->hard_nr_sectors = rq->nr_sectors += bio_sectors(bio);
+	}
+
+	rq->data_len += bio->bi_size;
+	return bio->bi_size;
+
+unmap_bio:
+	__blk_rq_discard_user(bio);
+	return ret;
+}
+
+static int blk_rq_map_user_range(request_queue_t *q, struct request *rq,
+				 void __user *ubuf, unsigned int len)
+{
+	unsigned int done = 0;
+	int ret;
+
+	while (done < len) {
+		ret = __blk_rq_map_user(q, rq, ubuf + done, len - done);
+		if (ret < 0)
+			return ret;
+		done += ret;
+	}
+
+	return 0;
+}
+
 /**
  * blk_rq_map_user - map user data to a request, for REQ_BLOCK_PC usage
  * @q:		request queue where request should be inserted
@@ -2137,55 +2264,38 @@ EXPORT_SYMBOL(blk_insert_request);
  * @len:	length of user data
  *
  * Description:
- *    Data will be mapped directly for zero copy io, if possible. Otherwise
- *    a kernel bounce buffer is used.
+ *    Data will be mapped directly for zero copy io, if possible.  A
+ *    buffer whose address or length violates the queue dma alignment is
+ *    bounced through kernel pages as a whole.  Aligned transfers larger
+ *    than one bio are built from a chain of bios, up to the queue's
+ *    max_sectors.
  *
  *    A matching blk_rq_unmap_user() must be issued at the end of io, while
- *    still in process context.
+ *    still in process context, on the bio that rq->bio pointed to after
+ *    this call.
  *
- *    Note: The mapped bio may need to be bounced through blk_queue_bounce()
- *    before being submitted to the device, as pages mapped may be out of
- *    reach. It's the callers responsibility to make sure this happens. The
- *    original bio must be passed back in to blk_rq_unmap_user() for proper
- *    unmapping.
+ *    Note: The mapped bios are bounced through blk_queue_bounce() here
+ *    as needed; callers must not bounce them again.
  */
 int blk_rq_map_user(request_queue_t *q, struct request *rq, void __user *ubuf,
 		    unsigned int len)
 {
-	unsigned long uaddr;
-	struct bio *bio;
-	int reading;
+	int ret;
 
 	if (len > (q->max_sectors << 9))
 		return -EINVAL;
 	if (!len || !ubuf)
 		return -EINVAL;
 
-	reading = rq_data_dir(rq) == READ;
-
-	/*
-	 * if alignment requirement is satisfied, map in user pages for
-	 * direct dma. else, set up kernel bounce buffers
-	 */
-	uaddr = (unsigned long) ubuf;
-	if (!(uaddr & queue_dma_alignment(q)) && !(len & queue_dma_alignment(q)))
-		bio = bio_map_user(q, NULL, uaddr, len, reading);
-	else
-		bio = bio_copy_user(q, uaddr, len, reading);
-
-	if (!IS_ERR(bio)) {
-		rq->bio = rq->biotail = bio;
-		blk_rq_bio_prep(q, rq, bio);
-
-		rq->buffer = rq->data = NULL;
-		rq->data_len = len;
-		return 0;
+	rq->data_len = 0;
+	ret = blk_rq_map_user_range(q, rq, ubuf, len);
+	if (ret) {
+		blk_rq_discard_user(rq);
+		return ret;
 	}
 
-	/*
-	 * bio is the err-ptr
-	 */
-	return PTR_ERR(bio);
+	rq->buffer = rq->data = NULL;
+	return 0;
 }
 
 EXPORT_SYMBOL(blk_rq_map_user);
@@ -2198,37 +2308,44 @@ EXPORT_SYMBOL(blk_rq_map_user);
  * @iov_count:	number of elements in the iovec
  *
  * Description:
- *    Data will be mapped directly for zero copy io, if possible. Otherwise
- *    a kernel bounce buffer is used.
+ *    Each iovec element is mapped like blk_rq_map_user() does, so data is
+ *    pinned for zero copy io wherever the dma alignment allows and only
+ *    misaligned elements are bounced.
  *
  *    A matching blk_rq_unmap_user() must be issued at the end of io, while
- *    still in process context.
- *
- *    Note: The mapped bio may need to be bounced through blk_queue_bounce()
- *    before being submitted to the device, as pages mapped may be out of
- *    reach. It's the callers responsibility to make sure this happens. The
- *    original bio must be passed back in to blk_rq_unmap_user() for proper
- *    unmapping.
+ *    still in process context, on the bio that rq->bio pointed to after
+ *    this call.
  */
 int blk_rq_map_user_iov(request_queue_t *q, struct request *rq,
 			struct sg_iovec *iov, int iov_count)
 {
-	struct bio *bio;
+	unsigned long total = 0;
+	int i, ret;
 
 	if (!iov || iov_count <= 0)
 		return -EINVAL;
 
-	/* we don't allow misaligned data like bio_map_user() does.  If the
-	 * user is using sg, they're expected to know the alignment constraints
-	 * and respect them accordingly */
-	bio = bio_map_user_iov(q, NULL, iov, iov_count, rq_data_dir(rq)== READ);
-	if (IS_ERR(bio))
-		return PTR_ERR(bio);
+	for (i = 0; i < iov_count; i++) {
+		if (!iov[i].iov_base && iov[i].iov_len)
+			return -EINVAL;
+		total += iov[i].iov_len;
+	}
+	if (!total || total > (q->max_sectors << 9))
+		return -EINVAL;
+
+	rq->data_len = 0;
+	for (i = 0; i < iov_count; i++) {
+		if (!iov[i].iov_len)
+			continue;
+		ret = blk_rq_map_user_range(q, rq, iov[i].iov_base,
+					    iov[i].iov_len);
+		if (ret) {
+			blk_rq_discard_user(rq);
+			return ret;
+		}
+	}
 
-	rq->bio = rq->biotail = bio;
-	blk_rq_bio_prep(q, rq, bio);
 	rq->buffer = rq->data = NULL;
-	rq->data_len = bio->bi_size;
 	return 0;
 }
 
@@ -2236,24 +2353,33 @@ EXPORT_SYMBOL(blk_rq_map_user_iov);
 
 /**
  * blk_rq_unmap_user - unmap a request with user data
- * @bio:	bio to be unmapped
+ * @bio:	start of the bio chain to be unmapped
  * @ulen:	length of user buffer
  *
  * Description:
- *    Unmap a bio previously mapped by blk_rq_map_user().
+ *    Unmap a bio chain previously mapped by blk_rq_map_user() or
+ *    blk_rq_map_user_iov(), copying bounced data back to user space.
  */
 int blk_rq_unmap_user(struct bio *bio, unsigned int ulen)
 {
-	int ret = 0;
+	struct bio *mapped_bio;
+	int ret = 0, ret2;
 
-	if (bio) {
-		if (bio_flagged(bio, BIO_USER_MAPPED))
-			bio_unmap_user(bio);
-		else
-			ret = bio_uncopy_user(bio);
+	while (bio) {
+		mapped_bio = bio;
+		if (unlikely(bio_flagged(bio, BIO_BOUNCED)))
+			mapped_bio = bio->bi_private;
+
+		ret2 = __blk_rq_unmap_user(mapped_bio);
+		if (ret2 && !ret)
+			ret = ret2;
+
+		mapped_bio = bio;
+		bio = bio->bi_next;
+		bio_put(mapped_bio);
 	}
 
-	return 0;
+	return ret;
 }
 
 EXPORT_SYMBOL(blk_rq_unmap_user);
@@ -3523,6 +3649,26 @@ static ssize_t queue_max_hw_sectors_show(struct request_queue *q, char *page)
 	return queue_var_show(max_hw_sectors_kb, (page));
 }
 
+static ssize_t queue_bdi_stat_show(struct request_queue *q, char *page)
+{
+	struct backing_dev_info *bdi = &q->backing_dev_info;
+	long background_thresh, dirty_thresh, bdi_thresh;
+
+	get_bdi_dirty_limits(bdi, &background_thresh, &dirty_thresh,
+			     &bdi_thresh);
+
+#define K(x) ((unsigned long)(x) << (PAGE_CACHE_SHIFT - 10))
+	return sprintf(page,
+		       "BdiReclaimable:   %8lu kB\n"
+		       "BdiWriteback:     %8lu kB\n"
+		       "BdiDirtyThresh:   %8lu kB\n"
+		       "DirtyThresh:      %8lu kB\n"
+		       "BackgroundThresh: %8lu kB\n",
+		       K(bdi_stat(bdi, BDI_RECLAIMABLE)),
+		       K(bdi_stat(bdi, BDI_WRITEBACK)),
+		       K(bdi_thresh), K(dirty_thresh), K(background_thresh));
+#undef K
+}
 
 static struct queue_sysfs_entry queue_requests_entry = {
 	.attr = {.name = "nr_requests", .mode = S_IRUGO | S_IWUSR },
@@ -3547,6 +3693,11 @@ static struct queue_sysfs_entry queue_max_hw_sectors_entry = {
 	.show = queue_max_hw_sectors_show,
 };
 
+static struct queue_sysfs_entry queue_bdi_stat_entry = {
+	.attr = {.name = "bdi_stat", .mode = S_IRUGO },
+	.show = queue_bdi_stat_show,
+};
+
 static struct queue_sysfs_entry queue_iosched_entry = {
 	.attr = {.name = "scheduler", .mode = S_IRUGO | S_IWUSR },
 	.show = elv_iosched_show,
@@ -3558,6 +3709,7 @@ static struct attribute *default_attrs[] = {
 	&queue_ra_entry.attr,
 	&queue_max_hw_sectors_entry.attr,
 	&queue_max_sectors_entry.attr,
+	&queue_bdi_stat_entry.attr,
 	&queue_iosched_entry.attr,
 	NULL,
 };
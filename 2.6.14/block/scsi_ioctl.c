@@ -289,15 +289,9 @@ static int sg_io(struct file *file, request_queue_t *q,
 	rq->sense_len = 0;
 
 	rq->flags |= REQ_BLOCK_PC;
+	/* the mapping helpers already bounced the chain as needed */
 	bio = rq->bio;
 
-	/*
-	 * bounce this after holding a reference to the original bio, it's
-	 * needed for proper unmapping
-	 */
-	if (rq->bio)
-		blk_queue_bounce(q, &rq->bio);
-
 	rq->timeout = (hdr->timeout * HZ) / 1000;
 	if (!rq->timeout)
 		rq->timeout = q->sg_timeout;
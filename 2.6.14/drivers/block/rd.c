@@ -451,6 +451,8 @@ static int __init rd_init(void)
 		       rd_blocksize);
 		rd_blocksize = BLOCK_SIZE;
 	}
+	bdi_init(&rd_backing_dev_info);
+	bdi_init(&rd_file_backing_dev_info);
 	/*分配gendisk*/
 	for (i = 0; i < CONFIG_BLK_DEV_RAM_COUNT; i++) {
 		rd_disks[i] = alloc_disk(1);
@@ -212,17 +212,40 @@ static struct scsi_host_cmd_pool scsi_cmd_dma_pool = {
 
 static DECLARE_MUTEX(host_cmd_pool_mutex);
 
+/*
+ * Per-CPU command cache.  Each host keeps a small stack of free commands
+ * per CPU so that the common allocation and free paths neither take
+ * free_list_lock nor touch the shared slab.  The cache is only ever
+ * accessed with local interrupts disabled, as scsi_put_command() may be
+ * called from the completion softirq.
+ */
+#define SCSI_CMD_PCPU_DEPTH	16
+
+struct scsi_cmd_pcpu_cache {
+	unsigned int		nr;
+	struct scsi_cmnd	*cmds[SCSI_CMD_PCPU_DEPTH];
+};
+
 static struct scsi_cmnd *__scsi_get_command(struct Scsi_Host *shost,
 					    gfp_t gfp_mask)
 {
-	struct scsi_cmnd *cmd;
+	struct scsi_cmd_pcpu_cache *cache;
+	struct scsi_cmnd *cmd = NULL;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	cache = per_cpu_ptr(shost->cmd_pcpu_cache, smp_processor_id());
+	if (likely(cache->nr))
+		cmd = cache->cmds[--cache->nr];
+	local_irq_restore(flags);
+
+	if (likely(cmd))
+		return cmd;
 
 	cmd = kmem_cache_alloc(shost->cmd_pool->slab,
 			gfp_mask | shost->cmd_pool->gfp_mask);
 
 	if (unlikely(!cmd)) {
-		unsigned long flags;
-
 		spin_lock_irqsave(&shost->free_list_lock, flags);
 		if (likely(!list_empty(&shost->free_list))) {
 			cmd = list_entry(shost->free_list.next,
@@ -288,6 +311,7 @@ void scsi_put_command(struct scsi_cmnd *cmd)
 {
 	struct scsi_device *sdev = cmd->device;
 	struct Scsi_Host *shost = sdev->host;
+	struct scsi_cmd_pcpu_cache *cache;
 	unsigned long flags;
 	
 	/* serious error if the command hasn't come from a device list */
@@ -295,15 +319,32 @@ void scsi_put_command(struct scsi_cmnd *cmd)
 	BUG_ON(list_empty(&cmd->list));
 	list_del_init(&cmd->list);
 	spin_unlock(&cmd->device->list_lock);
-	/* changing locks here, don't need to restore the irq state */
-	spin_lock(&shost->free_list_lock);
+
+	/*
+	 * Interrupts stay disabled from here on.  The backup command is
+	 * refilled first so that forward progress is always guaranteed;
+	 * the unlocked list_empty() is only a hint and is rechecked under
+	 * free_list_lock.
+	 */
 	if (unlikely(list_empty(&shost->free_list))) {
-		list_add(&cmd->list, &shost->free_list);
-		cmd = NULL;
+		spin_lock(&shost->free_list_lock);
+		if (list_empty(&shost->free_list)) {
+			list_add(&cmd->list, &shost->free_list);
+			cmd = NULL;
+		}
+		spin_unlock(&shost->free_list_lock);
+	}
+
+	if (likely(cmd != NULL)) {
+		cache = per_cpu_ptr(shost->cmd_pcpu_cache, smp_processor_id());
+		if (likely(cache->nr < SCSI_CMD_PCPU_DEPTH)) {
+			cache->cmds[cache->nr++] = cmd;
+			cmd = NULL;
+		}
 	}
-	spin_unlock_irqrestore(&shost->free_list_lock, flags);
+	local_irq_restore(flags);
 
-	if (likely(cmd != NULL))
+	if (unlikely(cmd != NULL))
 		kmem_cache_free(shost->cmd_pool->slab, cmd);
 
 	put_device(&sdev->sdev_gendev);
@@ -345,19 +386,28 @@ int scsi_setup_command_freelist(struct Scsi_Host *shost)
 	shost->cmd_pool = pool;
 	up(&host_cmd_pool_mutex);
 
+	shost->cmd_pcpu_cache = alloc_percpu(struct scsi_cmd_pcpu_cache);
+	if (!shost->cmd_pcpu_cache)
+		goto fail2;
+
 	/*
 	 * Get one backup command for this host.
 	 */
 	cmd = kmem_cache_alloc(shost->cmd_pool->slab,
 			GFP_KERNEL | shost->cmd_pool->gfp_mask);
 	if (!cmd)
-		goto fail2;
+		goto fail3;
 	list_add(&cmd->list, &shost->free_list);		
 	return 0;
 
+ fail3:
+	free_percpu(shost->cmd_pcpu_cache);
+	shost->cmd_pcpu_cache = NULL;
  fail2:
+	down(&host_cmd_pool_mutex);
 	if (!--pool->users)
 		kmem_cache_destroy(pool->slab);
+	up(&host_cmd_pool_mutex);
 	return -ENOMEM;
  fail:
 	up(&host_cmd_pool_mutex);
@@ -374,6 +424,19 @@ int scsi_setup_command_freelist(struct Scsi_Host *shost)
  */
 void scsi_destroy_command_freelist(struct Scsi_Host *shost)
 {
+	int cpu;
+
+	for_each_cpu(cpu) {
+		struct scsi_cmd_pcpu_cache *cache;
+
+		cache = per_cpu_ptr(shost->cmd_pcpu_cache, cpu);
+		while (cache->nr)
+			kmem_cache_free(shost->cmd_pool->slab,
+					cache->cmds[--cache->nr]);
+	}
+	free_percpu(shost->cmd_pcpu_cache);
+	shost->cmd_pcpu_cache = NULL;
+
 	while (!list_empty(&shost->free_list)) {
 		struct scsi_cmnd *cmd;
 
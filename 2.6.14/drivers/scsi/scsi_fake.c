@@ -0,0 +1,616 @@
+/*
+ * scsi_fake.c - virtual SCSI host adapter for exercising the mid-layer
+ *
+ * Presents a single host with one target and a configurable number of
+ * direct-access LUNs.  All LUNs share one RAM store; with fake_rw=1 the
+ * data is simply discarded, which allows capacities far larger than the
+ * store (virtual_gb) for pure command-path benchmarking.  Without
+ * fake_rw, a virtual_gb larger than the store wraps around it.
+ *
+ * Commands are completed through the normal scsi_done() path, either
+ * inline from queuecommand (delay=0) or from a per-command timer after
+ * 'delay' jiffies.  Medium errors and TASK SET FULL (QUEUE FULL) statuses
+ * can be injected on every Nth command so that the requeue, retry and
+ * queue-depth tracking logic in scsi_lib.c can be tested reproducibly.
+ *
+ * Example:
+ *	modprobe scsi_fake num_luns=4 dev_size_mb=64 queue_depth=32 \
+ *		delay=1 qfull_every=1000
+ */
+
+#include <linux/config.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/timer.h>
+#include <linux/spinlock.h>
+#include <linux/highmem.h>
+#include <linux/blkdev.h>
+#include <linux/device.h>
+#include <linux/init.h>
+#include <asm/scatterlist.h>
+
+#include <scsi/scsi.h>
+#include <scsi/scsi_cmnd.h>
+#include <scsi/scsi_device.h>
+#include <scsi/scsi_host.h>
+#include <scsi/scsi_tcq.h>
+
+#define FAKE_NAME		"scsi_fake"
+#define FAKE_SECTOR_SIZE	512
+#define FAKE_MAX_LUNS		256
+#define FAKE_MAX_QUEUE		255
+#define FAKE_INQ_LEN		36
+
+/* Additional sense codes used below */
+#define FAKE_ASC_UNRECOVERED	0x11
+#define FAKE_ASC_INVALID_OPCODE	0x20
+#define FAKE_ASC_LBA_OUT_RANGE	0x21
+#define FAKE_ASC_INVALID_FIELD	0x24
+
+static int num_luns = 1;
+static int dev_size_mb = 8;
+static int virtual_gb;
+static int fake_rw;
+static int queue_depth = 32;
+static int delay;
+static int error_every;
+static int qfull_every;
+
+module_param(num_luns, int, S_IRUGO);
+MODULE_PARM_DESC(num_luns, "Number of LUNs on the fake target (default 1)");
+module_param(dev_size_mb, int, S_IRUGO);
+MODULE_PARM_DESC(dev_size_mb, "Size of the shared RAM store in MB (default 8)");
+module_param(virtual_gb, int, S_IRUGO);
+MODULE_PARM_DESC(virtual_gb, "Reported capacity in GB, 0 means dev_size_mb");
+module_param(fake_rw, int, S_IRUGO);
+MODULE_PARM_DESC(fake_rw, "Discard data instead of using the RAM store");
+module_param(queue_depth, int, S_IRUGO);
+MODULE_PARM_DESC(queue_depth, "Commands queued per host and per LUN (default 32)");
+module_param(delay, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(delay, "Completion delay in jiffies, 0 completes inline");
+module_param(error_every, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(error_every, "Fail every Nth read/write with MEDIUM ERROR");
+module_param(qfull_every, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(qfull_every, "Return TASK SET FULL for every Nth command");
+
+struct fake_queued_cmd {
+	struct timer_list	timer;
+	struct scsi_cmnd	*cmd;
+	void			(*done)(struct scsi_cmnd *);
+};
+
+struct fake_host {
+	spinlock_t		lock;		/* protects queued[] */
+	struct fake_queued_cmd	*queued;
+	unsigned int		nr_slots;
+	unsigned long		cmd_count;
+	unsigned long		rw_count;
+	struct Scsi_Host	*shost;
+	struct platform_device	*pdev;
+};
+
+static unsigned char *fake_store;
+static unsigned long fake_store_sectors;
+static sector_t fake_capacity;
+static struct fake_host *fake_host;
+
+static void fake_mk_sense(struct scsi_cmnd *cmd, int key, int asc)
+{
+	unsigned char *sb = cmd->sense_buffer;
+
+	memset(sb, 0, SCSI_SENSE_BUFFERSIZE);
+	sb[0] = 0x70;		/* fixed format, current error */
+	sb[2] = key;
+	sb[7] = 0xa;
+	sb[12] = asc;
+	cmd->result = (DRIVER_SENSE << 24) | SAM_STAT_CHECK_CONDITION;
+}
+
+/*
+ * Copy 'len' bytes of response data into the command's buffer and set
+ * the residual count.
+ */
+static void fake_fill_from_dev(struct scsi_cmnd *cmd, unsigned char *arr,
+			       unsigned int len)
+{
+	struct scatterlist *sg;
+	unsigned int done = 0;
+	int k;
+
+	len = min(len, cmd->request_bufflen);
+	if (!cmd->use_sg) {
+		memcpy(cmd->request_buffer, arr, len);
+		done = len;
+	} else {
+		sg = (struct scatterlist *)cmd->request_buffer;
+		for (k = 0; k < cmd->use_sg && done < len; k++, sg++) {
+			unsigned int n = min(sg->length, len - done);
+			unsigned char *kaddr;
+
+			kaddr = kmap_atomic(sg->page, KM_USER0);
+			memcpy(kaddr + sg->offset, arr + done, n);
+			kunmap_atomic(kaddr, KM_USER0);
+			done += n;
+		}
+	}
+	cmd->resid = cmd->request_bufflen - done;
+}
+
+/*
+ * Move 'nr' sectors starting at 'lba' between the RAM store and the
+ * command's buffer.  Each sector is contiguous in the store, so the copy
+ * is done sector by sector to keep the wrap-around trivial.
+ */
+static void fake_rw_store(struct scsi_cmnd *cmd, sector_t lba,
+			  unsigned int nr, int write)
+{
+	unsigned int total = nr * FAKE_SECTOR_SIZE;
+	unsigned int done = 0;
+	struct scatterlist sgl, *sg;
+	int nr_sg, k;
+
+	if (cmd->use_sg) {
+		sg = (struct scatterlist *)cmd->request_buffer;
+		nr_sg = cmd->use_sg;
+	} else {
+		sgl.page = virt_to_page(cmd->request_buffer);
+		sgl.offset = offset_in_page(cmd->request_buffer);
+		sgl.length = cmd->request_bufflen;
+		sg = &sgl;
+		nr_sg = 1;
+	}
+
+	for (k = 0; k < nr_sg && done < total; k++, sg++) {
+		unsigned int seg = min(sg->length, total - done);
+		unsigned char *kaddr;
+		unsigned int off = 0;
+
+		kaddr = kmap_atomic(sg->page, KM_USER0);
+		while (off < seg) {
+			unsigned int pos = done + off;
+			unsigned int in_sect = pos % FAKE_SECTOR_SIZE;
+			unsigned int n = min(seg - off, FAKE_SECTOR_SIZE - in_sect);
+			sector_t blk = lba + pos / FAKE_SECTOR_SIZE;
+			unsigned char *sp;
+
+			sp = fake_store + in_sect + (unsigned long)
+				sector_div(blk, fake_store_sectors) *
+				FAKE_SECTOR_SIZE;
+			if (write)
+				memcpy(sp, kaddr + sg->offset + off, n);
+			else
+				memcpy(kaddr + sg->offset + off, sp, n);
+			off += n;
+		}
+		kunmap_atomic(kaddr, KM_USER0);
+		done += seg;
+	}
+	cmd->resid = cmd->request_bufflen - done;
+}
+
+static void fake_inquiry(struct scsi_cmnd *cmd)
+{
+	unsigned char arr[FAKE_INQ_LEN];
+
+	if (cmd->cmnd[1] & 0x1) {	/* no VPD pages */
+		fake_mk_sense(cmd, ILLEGAL_REQUEST, FAKE_ASC_INVALID_FIELD);
+		return;
+	}
+
+	memset(arr, 0, sizeof(arr));
+	arr[0] = TYPE_DISK;
+	arr[2] = 5;			/* SPC-3 */
+	arr[3] = 2;			/* response data format */
+	arr[4] = FAKE_INQ_LEN - 5;
+	arr[7] = 0x2;			/* CmdQue */
+	memcpy(&arr[8], "Linux   ", 8);
+	memcpy(&arr[16], "scsi_fake       ", 16);
+	memcpy(&arr[32], "0001", 4);
+	fake_fill_from_dev(cmd, arr, sizeof(arr));
+}
+
+static void fake_read_capacity(struct scsi_cmnd *cmd)
+{
+	unsigned char arr[8];
+	sector_t last = fake_capacity - 1;
+	u32 last32 = (last > 0xffffffff) ? 0xffffffff : (u32)last;
+
+	arr[0] = last32 >> 24;
+	arr[1] = last32 >> 16;
+	arr[2] = last32 >> 8;
+	arr[3] = last32;
+	arr[4] = 0;
+	arr[5] = 0;
+	arr[6] = FAKE_SECTOR_SIZE >> 8;
+	arr[7] = FAKE_SECTOR_SIZE & 0xff;
+	fake_fill_from_dev(cmd, arr, sizeof(arr));
+}
+
+static void fake_read_capacity16(struct scsi_cmnd *cmd)
+{
+	unsigned char arr[32];
+	u64 last = (u64)fake_capacity - 1;
+	int k;
+
+	memset(arr, 0, sizeof(arr));
+	for (k = 0; k < 8; k++)
+		arr[k] = last >> (56 - 8 * k);
+	arr[10] = FAKE_SECTOR_SIZE >> 8;
+	arr[11] = FAKE_SECTOR_SIZE & 0xff;
+	fake_fill_from_dev(cmd, arr, sizeof(arr));
+}
+
+static void fake_report_luns(struct scsi_cmnd *cmd)
+{
+	unsigned int alloc_len = (cmd->cmnd[6] << 24) | (cmd->cmnd[7] << 16) |
+				 (cmd->cmnd[8] << 8) | cmd->cmnd[9];
+	unsigned int len = 8 + num_luns * 8;
+	unsigned char *arr;
+	int lun;
+
+	arr = kzalloc(len, GFP_ATOMIC);
+	if (!arr) {
+		cmd->result = DID_REQUEUE << 16;
+		return;
+	}
+	arr[0] = (num_luns * 8) >> 24;
+	arr[1] = (num_luns * 8) >> 16;
+	arr[2] = (num_luns * 8) >> 8;
+	arr[3] = (num_luns * 8) & 0xff;
+	for (lun = 0; lun < num_luns; lun++)
+		arr[8 + lun * 8 + 1] = lun;
+	fake_fill_from_dev(cmd, arr, min(len, alloc_len));
+	kfree(arr);
+}
+
+static void fake_mode_sense(struct scsi_cmnd *cmd)
+{
+	unsigned char arr[8];
+
+	/* header only, no block descriptors and no mode pages */
+	memset(arr, 0, sizeof(arr));
+	if (cmd->cmnd[0] == MODE_SENSE) {
+		arr[0] = 3;
+		fake_fill_from_dev(cmd, arr, 4);
+	} else {
+		arr[1] = 6;
+		fake_fill_from_dev(cmd, arr, 8);
+	}
+}
+
+static void fake_read_write(struct scsi_cmnd *cmd)
+{
+	unsigned char *cdb = cmd->cmnd;
+	int write = 0;
+	sector_t lba;
+	unsigned int num;
+	int k;
+
+	switch (cdb[0]) {
+	case WRITE_6:
+		write = 1;
+	case READ_6:
+		lba = ((cdb[1] & 0x1f) << 16) | (cdb[2] << 8) | cdb[3];
+		num = cdb[4] ? cdb[4] : 256;
+		break;
+	case WRITE_10:
+		write = 1;
+	case READ_10:
+		lba = ((u32)cdb[2] << 24) | (cdb[3] << 16) |
+		      (cdb[4] << 8) | cdb[5];
+		num = (cdb[7] << 8) | cdb[8];
+		break;
+	default:	/* READ_16 / WRITE_16 */
+		write = (cdb[0] == WRITE_16);
+		for (lba = 0, k = 0; k < 8; k++)
+			lba = (lba << 8) | cdb[2 + k];
+		num = (cdb[10] << 24) | (cdb[11] << 16) |
+		      (cdb[12] << 8) | cdb[13];
+		break;
+	}
+
+	if (lba + num > fake_capacity || lba + num < lba) {
+		fake_mk_sense(cmd, ILLEGAL_REQUEST, FAKE_ASC_LBA_OUT_RANGE);
+		return;
+	}
+
+	fake_host->rw_count++;
+	if (error_every > 0 && !(fake_host->rw_count % error_every)) {
+		fake_mk_sense(cmd, MEDIUM_ERROR, FAKE_ASC_UNRECOVERED);
+		return;
+	}
+
+	if (fake_rw)
+		cmd->resid = 0;
+	else
+		fake_rw_store(cmd, lba, num, write);
+}
+
+/*
+ * Completion timer: hand the command back to the mid-layer, which
+ * queues it on the per-CPU done queue and raises SCSI_SOFTIRQ.
+ */
+static void fake_timer_fn(unsigned long data)
+{
+	struct fake_queued_cmd *q = (struct fake_queued_cmd *)data;
+	void (*done)(struct scsi_cmnd *);
+	struct scsi_cmnd *cmd;
+	unsigned long flags;
+
+	spin_lock_irqsave(&fake_host->lock, flags);
+	cmd = q->cmd;
+	done = q->done;
+	q->cmd = NULL;
+	spin_unlock_irqrestore(&fake_host->lock, flags);
+
+	if (cmd)
+		done(cmd);
+}
+
+static int fake_schedule_done(struct scsi_cmnd *cmd,
+			      void (*done)(struct scsi_cmnd *))
+{
+	struct fake_queued_cmd *q;
+	unsigned long flags;
+	int k;
+
+	if (delay <= 0) {
+		done(cmd);
+		return 0;
+	}
+
+	spin_lock_irqsave(&fake_host->lock, flags);
+	for (k = 0; k < fake_host->nr_slots; k++)
+		if (!fake_host->queued[k].cmd)
+			break;
+	if (k == fake_host->nr_slots) {
+		spin_unlock_irqrestore(&fake_host->lock, flags);
+		return SCSI_MLQUEUE_HOST_BUSY;
+	}
+	q = &fake_host->queued[k];
+	q->cmd = cmd;
+	q->done = done;
+	mod_timer(&q->timer, jiffies + delay);
+	spin_unlock_irqrestore(&fake_host->lock, flags);
+	return 0;
+}
+
+/*
+ * Called with the host lock held.
+ */
+static int fake_queuecommand(struct scsi_cmnd *cmd,
+			     void (*done)(struct scsi_cmnd *))
+{
+	struct scsi_device *sdev = cmd->device;
+
+	cmd->result = 0;
+	if (sdev->id != 0 || sdev->lun >= num_luns) {
+		cmd->result = DID_NO_CONNECT << 16;
+		done(cmd);
+		return 0;
+	}
+
+	fake_host->cmd_count++;
+	if (qfull_every > 0 && !(fake_host->cmd_count % qfull_every)) {
+		cmd->result = SAM_STAT_TASK_SET_FULL;
+		return fake_schedule_done(cmd, done);
+	}
+
+	switch (cmd->cmnd[0]) {
+	case INQUIRY:
+		fake_inquiry(cmd);
+		break;
+	case REQUEST_SENSE: {
+		unsigned char arr[18];
+
+		memset(arr, 0, sizeof(arr));
+		arr[0] = 0x70;
+		arr[7] = 0xa;
+		fake_fill_from_dev(cmd, arr, sizeof(arr));
+		break;
+	}
+	case TEST_UNIT_READY:
+	case START_STOP:
+	case ALLOW_MEDIUM_REMOVAL:
+	case SYNCHRONIZE_CACHE:
+	case VERIFY:
+		break;
+	case READ_CAPACITY:
+		fake_read_capacity(cmd);
+		break;
+	case SERVICE_ACTION_IN:
+		if ((cmd->cmnd[1] & 0x1f) == SAI_READ_CAPACITY_16)
+			fake_read_capacity16(cmd);
+		else
+			fake_mk_sense(cmd, ILLEGAL_REQUEST,
+				      FAKE_ASC_INVALID_FIELD);
+		break;
+	case MODE_SENSE:
+	case MODE_SENSE_10:
+		fake_mode_sense(cmd);
+		break;
+	case REPORT_LUNS:
+		fake_report_luns(cmd);
+		break;
+	case READ_6:
+	case READ_10:
+	case READ_16:
+	case WRITE_6:
+	case WRITE_10:
+	case WRITE_16:
+		fake_read_write(cmd);
+		break;
+	default:
+		fake_mk_sense(cmd, ILLEGAL_REQUEST, FAKE_ASC_INVALID_OPCODE);
+		break;
+	}
+
+	return fake_schedule_done(cmd, done);
+}
+
+/*
+ * Drop a queued command without completing it; the error handler owns
+ * it from here.  Returns 1 if the command was found.
+ */
+static int fake_stop_queued(struct scsi_cmnd *cmd)
+{
+	unsigned long flags;
+	int k, found = 0;
+
+	spin_lock_irqsave(&fake_host->lock, flags);
+	for (k = 0; k < fake_host->nr_slots; k++) {
+		struct fake_queued_cmd *q = &fake_host->queued[k];
+
+		if (q->cmd && (!cmd || q->cmd == cmd)) {
+			del_timer(&q->timer);
+			q->cmd = NULL;
+			found = 1;
+		}
+	}
+	spin_unlock_irqrestore(&fake_host->lock, flags);
+	return found;
+}
+
+static int fake_abort(struct scsi_cmnd *cmd)
+{
+	fake_stop_queued(cmd);
+	return SUCCESS;
+}
+
+static int fake_reset(struct scsi_cmnd *cmd)
+{
+	fake_stop_queued(NULL);
+	return SUCCESS;
+}
+
+static int fake_slave_configure(struct scsi_device *sdev)
+{
+	scsi_adjust_queue_depth(sdev, MSG_SIMPLE_TAG, queue_depth);
+	return 0;
+}
+
+static struct scsi_host_template fake_template = {
+	.module			= THIS_MODULE,
+	.name			= "SCSI fake host",
+	.proc_name		= FAKE_NAME,
+	.queuecommand		= fake_queuecommand,
+	.slave_configure	= fake_slave_configure,
+	.eh_abort_handler	= fake_abort,
+	.eh_bus_reset_handler	= fake_reset,
+	.eh_host_reset_handler	= fake_reset,
+	.can_queue		= FAKE_MAX_QUEUE,
+	.this_id		= 7,
+	.sg_tablesize		= 256,
+	.cmd_per_lun		= 16,
+	.max_sectors		= 0xffff,
+	.use_clustering		= DISABLE_CLUSTERING,
+};
+
+static int __init fake_init(void)
+{
+	struct Scsi_Host *shost;
+	int k, error = -ENOMEM;
+
+	if (num_luns < 1 || num_luns > FAKE_MAX_LUNS ||
+	    queue_depth < 1 || queue_depth > FAKE_MAX_QUEUE ||
+	    dev_size_mb < 1 || virtual_gb < 0) {
+		printk(KERN_ERR FAKE_NAME ": invalid module parameters\n");
+		return -EINVAL;
+	}
+
+	fake_store_sectors = ((unsigned long)dev_size_mb << 20) /
+			     FAKE_SECTOR_SIZE;
+	if (virtual_gb)
+		fake_capacity = (sector_t)virtual_gb << (30 - 9);
+	else
+		fake_capacity = fake_store_sectors;
+
+	if (!fake_rw) {
+		fake_store = vmalloc(fake_store_sectors * FAKE_SECTOR_SIZE);
+		if (!fake_store)
+			return -ENOMEM;
+		memset(fake_store, 0, fake_store_sectors * FAKE_SECTOR_SIZE);
+	}
+
+	fake_host = kzalloc(sizeof(*fake_host), GFP_KERNEL);
+	if (!fake_host)
+		goto out_store;
+	spin_lock_init(&fake_host->lock);
+	fake_host->nr_slots = queue_depth;
+	fake_host->queued = kcalloc(queue_depth, sizeof(struct fake_queued_cmd),
+				    GFP_KERNEL);
+	if (!fake_host->queued)
+		goto out_host;
+	for (k = 0; k < queue_depth; k++) {
+		init_timer(&fake_host->queued[k].timer);
+		fake_host->queued[k].timer.function = fake_timer_fn;
+		fake_host->queued[k].timer.data =
+			(unsigned long)&fake_host->queued[k];
+	}
+
+	fake_host->pdev = platform_device_register_simple(FAKE_NAME, -1,
+							  NULL, 0);
+	if (IS_ERR(fake_host->pdev)) {
+		error = PTR_ERR(fake_host->pdev);
+		goto out_queued;
+	}
+
+	error = -ENOMEM;
+	shost = scsi_host_alloc(&fake_template, 0);
+	if (!shost)
+		goto out_pdev;
+	shost->max_id = 1;
+	shost->max_lun = num_luns;
+	shost->max_cmd_len = 16;
+	shost->can_queue = queue_depth;
+	shost->cmd_per_lun = queue_depth;
+	fake_host->shost = shost;
+
+	error = scsi_add_host(shost, &fake_host->pdev->dev);
+	if (error)
+		goto out_shost;
+	scsi_scan_host(shost);
+
+	printk(KERN_INFO FAKE_NAME ": %d LUN(s), %llu sectors, "
+	       "queue depth %d, %s\n", num_luns,
+	       (unsigned long long)fake_capacity, queue_depth,
+	       fake_rw ? "data discarded" : "RAM backed");
+	return 0;
+
+out_shost:
+	scsi_host_put(shost);
+out_pdev:
+	platform_device_unregister(fake_host->pdev);
+out_queued:
+	kfree(fake_host->queued);
+out_host:
+	kfree(fake_host);
+out_store:
+	vfree(fake_store);
+	return error;
+}
+
+static void __exit fake_exit(void)
+{
+	int k;
+
+	scsi_remove_host(fake_host->shost);
+	fake_stop_queued(NULL);
+	for (k = 0; k < fake_host->nr_slots; k++)
+		del_timer_sync(&fake_host->queued[k].timer);
+	scsi_host_put(fake_host->shost);
+	platform_device_unregister(fake_host->pdev);
+	kfree(fake_host->queued);
+	kfree(fake_host);
+	vfree(fake_store);
+}
+
+module_init(fake_init);
+module_exit(fake_exit);
+
+MODULE_DESCRIPTION("Virtual SCSI host adapter for mid-layer testing");
+MODULE_LICENSE("GPL");
@@ -30,6 +30,11 @@
 #include <linux/workqueue.h>
 #include <linux/security.h>
 #include <linux/rcuref.h>
+#include <linux/pagemap.h>
+#include <linux/pagevec.h>
+#include <linux/blkdev.h>
+#include <linux/poll.h>
+#include <linux/mount.h>
 
 #include <asm/kmap_types.h>
 #include <asm/uaccess.h>
@@ -50,6 +55,8 @@ static kmem_cache_t	*kiocb_cachep;
 static kmem_cache_t	*kioctx_cachep;
 
 static struct workqueue_struct *aio_wq;
+/* Runs the writeback and ->fsync stages of IOCB_CMD_FSYNC/FDSYNC */
+static struct workqueue_struct *aio_fsync_wq;
 
 /* Used for rare fput completion. */
 static void aio_fput_routine(void *);
@@ -61,6 +68,12 @@ static LIST_HEAD(fput_head);
 static void aio_kick_handler(void *);
 static void aio_queue_work(struct kioctx *);
 
+/* kiocbs io_submit() allocates and reserves ring space for at a time */
+#define AIO_SUBMIT_BATCH	32
+
+static struct file_system_type aio_fs_type;
+static struct vfsmount *aio_mnt;
+
 /* aio_setup
  *	Creates the slab caches used by the aio routines, panic on
  *	failure as this is done early during the boot sequence.
@@ -73,6 +86,13 @@ static int __init aio_setup(void)
 				0, SLAB_HWCACHE_ALIGN|SLAB_PANIC, NULL, NULL);
 
 	aio_wq = create_workqueue("aio");
+	aio_fsync_wq = create_workqueue("aio_fsync");
+
+	if (register_filesystem(&aio_fs_type))
+		panic("aio: cannot register aiofs\n");
+	aio_mnt = kern_mount(&aio_fs_type);
+	if (IS_ERR(aio_mnt))
+		panic("aio: cannot mount aiofs\n");
 
 	pr_debug("aio_setup: sizeof(struct page) = %d\n", (int)sizeof(struct page));
 
@@ -377,71 +397,89 @@ void fastcall __put_ioctx(struct kioctx *ctx)
 	atomic_sub(nr_events, &aio_nr);
 }
 
-/* aio_get_req
- *	Allocate a slot for an aio request.  Increments the users count
- * of the kioctx so that the kioctx stays around until all requests are
- * complete.  Returns NULL if no requests are free.
+/* aio_get_reqs
+ *	Allocate slots for up to nr aio requests.  Increments the users count
+ * of the kioctx once per request so that the kioctx stays around until all
+ * requests are complete.  Returns the number of requests allocated, which
+ * is 0 if no requests are free.
+ *
+ * The completion ring space for the whole batch is reserved with a single
+ * ctx_lock round trip, so io_submit() of many iocbs doesn't bounce the lock
+ * once per iocb.
  *
  * Returns with kiocb->users set to 2.  The io submit code path holds
  * an extra reference while submitting the i/o.
  * This prevents races between the aio code path referencing the
  * req (after submitting it) and aio_complete() freeing the req.
  */
-static struct kiocb *FASTCALL(__aio_get_req(struct kioctx *ctx));
-static struct kiocb fastcall *__aio_get_req(struct kioctx *ctx)
+static int __aio_get_reqs(struct kioctx *ctx, struct kiocb **reqs, int nr)
 {
-	struct kiocb *req = NULL;
+	struct kiocb *req;
 	struct aio_ring *ring;
-	int okay = 0;
+	unsigned avail;
+	int i, got = 0;
 
-	req = kmem_cache_alloc(kiocb_cachep, GFP_KERNEL);
-	if (unlikely(!req))
-		return NULL;
+	for (i = 0; i < nr; i++) {
+		req = kmem_cache_alloc(kiocb_cachep, GFP_KERNEL);
+		if (unlikely(!req))
+			break;
 
-	req->ki_flags = 0;
-	req->ki_users = 2;
-	req->ki_key = 0;
-	req->ki_ctx = ctx;
-	req->ki_cancel = NULL;
-	req->ki_retry = NULL;
-	req->ki_dtor = NULL;
-	req->private = NULL;
-	INIT_LIST_HEAD(&req->ki_run_list);
+		req->ki_flags = 0;
+		req->ki_users = 2;
+		req->ki_key = 0;
+		req->ki_ctx = ctx;
+		req->ki_cancel = NULL;
+		req->ki_retry = NULL;
+		req->ki_dtor = NULL;
+		req->ki_iovec = NULL;
+		req->private = NULL;
+		INIT_LIST_HEAD(&req->ki_run_list);
+		reqs[i] = req;
+	}
+	nr = i;
 
 	/* Check if the completion queue has enough free space to
-	 * accept an event from this io.
+	 * accept an event from each io.
 	 */
 	spin_lock_irq(&ctx->ctx_lock);
 	ring = kmap_atomic(ctx->ring_info.ring_pages[0], KM_USER0);
-	if (ctx->reqs_active < aio_ring_avail(&ctx->ring_info, ring)) {
-		list_add(&req->ki_list, &ctx->active_reqs);
+	avail = aio_ring_avail(&ctx->ring_info, ring);
+	while (got < nr && ctx->reqs_active < avail) {
+		list_add(&reqs[got]->ki_list, &ctx->active_reqs);
 		get_ioctx(ctx);
 		ctx->reqs_active++;
-		okay = 1;
+		got++;
 	}
 	kunmap_atomic(ring, KM_USER0);
 	spin_unlock_irq(&ctx->ctx_lock);
 
-	if (!okay) {
-		kmem_cache_free(kiocb_cachep, req);
-		req = NULL;
-	}
+	for (i = got; i < nr; i++)
+		kmem_cache_free(kiocb_cachep, reqs[i]);
 
-	return req;
+	return got;
 }
 
-static inline struct kiocb *aio_get_req(struct kioctx *ctx)
+static int aio_get_reqs(struct kioctx *ctx, struct kiocb **reqs, int nr)
 {
-	struct kiocb *req;
+	int got;
 	/* Handle a potential starvation case -- should be exceedingly rare as 
 	 * requests will be stuck on fput_head only if the aio_fput_routine is 
 	 * delayed and the requests were the last user of the struct file.
 	 */
-	req = __aio_get_req(ctx);
-	if (unlikely(NULL == req)) {
+	got = __aio_get_reqs(ctx, reqs, nr);
+	if (unlikely(!got)) {
 		aio_fput_routine(NULL);
-		req = __aio_get_req(ctx);
+		got = __aio_get_reqs(ctx, reqs, nr);
 	}
+	return got;
+}
+
+static inline struct kiocb *aio_get_req(struct kioctx *ctx)
+{
+	struct kiocb *req;
+
+	if (!aio_get_reqs(ctx, &req, 1))
+		return NULL;
 	return req;
 }
 
@@ -449,6 +487,8 @@ static inline void really_put_req(struct kioctx *ctx, struct kiocb *req)
 {
 	if (req->ki_dtor)
 		req->ki_dtor(req);
+	if (req->ki_iovec != &req->ki_inline_vec)
+		kfree(req->ki_iovec);
 	kmem_cache_free(kiocb_cachep, req);
 	ctx->reqs_active--;
 
@@ -689,6 +729,7 @@ static ssize_t aio_run_iocb(struct kiocb *iocb)
 	 */
 
 	kiocbClearKicked(iocb);
+	kiocbClearWaiting(iocb);
 
 	/*
 	 * This is so that aio_complete knows it doesn't need to
@@ -1225,6 +1266,9 @@ static void io_destroy(struct kioctx *ioctx)
 		*tmp = ioctx->next;
 	write_unlock(&mm->ioctx_list_lock);
 
+	/* wake sys_io_getfd() pollers so they see POLLHUP */
+	wake_up(&ioctx->wait);
+
 	dprintk("aio_release(%p)\n", ioctx);
 	if (likely(!was_dead))
 		put_ioctx(ioctx);	/* twice for the list */
@@ -1300,7 +1344,9 @@ asmlinkage long sys_io_destroy(aio_context_t ctx)
  * IO_CMD_P{READ,WRITE}.  They maintains kiocb retry state around potentially
  * multiple calls to f_op->aio_read().  They loop around partial progress
  * instead of returning -EIOCBRETRY because they don't have the means to call
- * kick_iocb().
+ * kick_iocb().  The exception is a buffered read that reaches a page still
+ * under I/O: the page cache queues the kiocb on the page (see
+ * wait_on_page_bit_async()) and we back out with -EIOCBRETRY.
  */
 static ssize_t aio_pread(struct kiocb *iocb)
 {
@@ -1324,11 +1370,20 @@ static ssize_t aio_pread(struct kiocb *iocb)
 		/*
 		 * For pipes and sockets we return once we have some data; for
 		 * regular files we retry till we complete the entire read or
-		 * find that we can't read any more data (e.g short reads).
+		 * find that we can't read any more data (e.g short reads), or
+		 * the read has queued us on a page that is still under I/O.
 		 */
-	} while (ret > 0 && iocb->ki_left > 0 &&
+	} while (ret > 0 && iocb->ki_left > 0 && !kiocbIsWaiting(iocb) &&
 		 !S_ISFIFO(inode->i_mode) && !S_ISSOCK(inode->i_mode));
 
+	/*
+	 * A buffered read stopped at a page that isn't uptodate yet and the
+	 * kiocb is on that page's wait queue.  Whatever we copied so far is
+	 * accounted in ki_buf/ki_left/ki_pos; the kick will resume from there.
+	 */
+	if (kiocbIsWaiting(iocb))
+		return -EIOCBRETRY;
+
 	/* This means we must have transferred all that we could */
 	/* No need to retry anymore */
 	if ((ret == 0) || (iocb->ki_left == 0))
@@ -1358,6 +1413,74 @@ static ssize_t aio_pwrite(struct kiocb *iocb)
 	return ret;
 }
 
+/*
+ * Step the kiocb's iovec past the ret bytes the last call transferred.
+ */
+static void aio_advance_iovec(struct kiocb *iocb, ssize_t ret)
+{
+	struct iovec *iov = &iocb->ki_iovec[iocb->ki_cur_seg];
+
+	BUG_ON(ret <= 0);
+
+	while (iocb->ki_cur_seg < iocb->ki_nr_segs && ret > 0) {
+		ssize_t this = min((ssize_t)iov->iov_len, ret);
+		iov->iov_base += this;
+		iov->iov_len -= this;
+		iocb->ki_left -= this;
+		ret -= this;
+		if (iov->iov_len == 0) {
+			iocb->ki_cur_seg++;
+			iov++;
+		}
+	}
+
+	/* the caller should never ask us to advance past the end */
+	BUG_ON(ret > 0 && iocb->ki_left == 0);
+}
+
+/*
+ * ki_retry method for IOCB_CMD_P{READ,WRITE}V.  Works like aio_p{read,write}
+ * but hands the whole remaining iovec to ->aio_{read,write}v, so the
+ * filesystem can turn it into a single direct I/O or a single pass over the
+ * page cache.
+ */
+static ssize_t aio_rw_vect_retry(struct kiocb *iocb)
+{
+	struct file *file = iocb->ki_filp;
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = mapping->host;
+	ssize_t (*rw_op)(struct kiocb *, const struct iovec *,
+			 unsigned long, loff_t);
+	ssize_t ret = 0;
+
+	if (iocb->ki_opcode == IOCB_CMD_PREADV)
+		rw_op = file->f_op->aio_readv;
+	else
+		rw_op = file->f_op->aio_writev;
+
+	do {
+		ret = rw_op(iocb, &iocb->ki_iovec[iocb->ki_cur_seg],
+			    iocb->ki_nr_segs - iocb->ki_cur_seg,
+			    iocb->ki_pos);
+		if (ret > 0)
+			aio_advance_iovec(iocb, ret);
+
+	/* retry all partial writes.  retry partial reads as long as its a
+	 * regular file. */
+	} while (ret > 0 && iocb->ki_left > 0 && !kiocbIsWaiting(iocb) &&
+		 (iocb->ki_opcode == IOCB_CMD_PWRITEV ||
+		  (!S_ISFIFO(inode->i_mode) && !S_ISSOCK(inode->i_mode))));
+
+	/* see aio_pread() */
+	if (kiocbIsWaiting(iocb))
+		return -EIOCBRETRY;
+
+	if ((ret == 0) || (iocb->ki_left == 0))
+		ret = iocb->ki_nbytes - iocb->ki_left;
+
+	return ret;
+}
+
 static ssize_t aio_fdsync(struct kiocb *iocb)
 {
 	struct file *file = iocb->ki_filp;
@@ -1378,6 +1501,196 @@ static ssize_t aio_fsync(struct kiocb *iocb)
 	return ret;
 }
 
+/*
+ * Generic IOCB_CMD_F{,D}SYNC for files without ->aio_fsync.
+ *
+ * Nothing here may block the submitter, so the work is split up:
+ *
+ *  AIO_FSYNC_WRITEOUT	aio_fsync_wq starts writeback with
+ *			filemap_fdatawrite() and kicks the iocb.
+ *  AIO_FSYNC_WAIT	the retry walks the pages under writeback and
+ *			parks the iocb on each one still in flight with
+ *			wait_on_page_bit_async(); end_page_writeback()
+ *			kicks it again.
+ *  AIO_FSYNC_COMMIT	aio_fsync_wq writes the inode through ->fsync,
+ *			flushes the disk cache and calls aio_complete().
+ */
+enum {
+	AIO_FSYNC_WRITEOUT,
+	AIO_FSYNC_WAIT,
+	AIO_FSYNC_COMMIT,
+};
+
+struct aio_fsync_state {
+	struct work_struct	work;
+	struct kiocb		*iocb;
+	int			stage;
+	int			error;
+	pgoff_t			index;		/* AIO_FSYNC_WAIT cursor */
+};
+
+static void aio_fsync_dtor(struct kiocb *iocb)
+{
+	kfree(iocb->private);
+}
+
+static void aio_fsync_work(void *data)
+{
+	struct aio_fsync_state *state = data;
+	struct kiocb *iocb = state->iocb;
+	struct file *file = iocb->ki_filp;
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = mapping->host;
+	struct block_device *bdev;
+	int datasync = (iocb->ki_opcode == IOCB_CMD_FDSYNC);
+	int err;
+
+	current->flags |= PF_SYNCWRITE;
+	if (state->stage == AIO_FSYNC_WRITEOUT) {
+		state->error = filemap_fdatawrite(mapping);
+		state->stage = AIO_FSYNC_WAIT;
+		current->flags &= ~PF_SYNCWRITE;
+		kick_iocb(iocb);
+		return;
+	}
+
+	/*
+	 * We need to protect against concurrent writers,
+	 * which could cause livelocks in fsync_buffers_list
+	 */
+	down(&inode->i_sem);
+	err = file->f_op->fsync(file, file->f_dentry, datasync);
+	if (!state->error)
+		state->error = err;
+	up(&inode->i_sem);
+
+	/* picks up whatever ->fsync() itself sent to the page cache */
+	err = filemap_fdatawait(mapping);
+	if (!state->error)
+		state->error = err;
+	current->flags &= ~PF_SYNCWRITE;
+
+	if (S_ISBLK(inode->i_mode))
+		bdev = I_BDEV(inode);
+	else
+		bdev = inode->i_sb->s_bdev;
+	if (bdev && !state->error) {
+		err = blkdev_issue_flush(bdev, NULL);
+		if (err != -EOPNOTSUPP)
+			state->error = err;
+	}
+
+	aio_complete(iocb, state->error, 0);
+}
+
+static ssize_t aio_generic_fsync(struct kiocb *iocb)
+{
+	struct aio_fsync_state *state = iocb->private;
+	struct address_space *mapping = iocb->ki_filp->f_mapping;
+	struct pagevec pvec;
+	int nr_pages, i;
+	ssize_t ret;
+
+	if (!state) {
+		state = kmalloc(sizeof(*state), GFP_KERNEL);
+		if (!state)
+			return -ENOMEM;
+		INIT_WORK(&state->work, aio_fsync_work, state);
+		state->iocb = iocb;
+		state->stage = AIO_FSYNC_WRITEOUT;
+		state->error = 0;
+		state->index = 0;
+		iocb->private = state;
+		iocb->ki_dtor = aio_fsync_dtor;
+		queue_work(aio_fsync_wq, &state->work);
+		/* the worker kicks us once writeback has been started */
+		return -EIOCBRETRY;
+	}
+
+	/* spurious kick while the writeout is still being started */
+	if (state->stage != AIO_FSYNC_WAIT)
+		return -EIOCBRETRY;
+
+	pagevec_init(&pvec, 0);
+	while ((nr_pages = pagevec_lookup_tag(&pvec, mapping, &state->index,
+				PAGECACHE_TAG_WRITEBACK, PAGEVEC_SIZE)) != 0) {
+		for (i = 0; i < nr_pages; i++) {
+			struct page *page = pvec.pages[i];
+
+			ret = wait_on_page_bit_async(page, PG_writeback);
+			if (ret) {
+				/* resume from this page when it is done */
+				state->index = page->index;
+				pagevec_release(&pvec);
+				return ret;
+			}
+			if (PageError(page))
+				state->error = -EIO;
+		}
+		pagevec_release(&pvec);
+	}
+
+	/* Check for outstanding write errors */
+	if (test_and_clear_bit(AS_ENOSPC, &mapping->flags))
+		state->error = -ENOSPC;
+	if (test_and_clear_bit(AS_EIO, &mapping->flags))
+		state->error = -EIO;
+
+	state->stage = AIO_FSYNC_COMMIT;
+	queue_work(aio_fsync_wq, &state->work);
+	return -EIOCBQUEUED;
+}
+
+/*
+ * aio_setup_vectored_rw:
+ *	Copy in and check the iovec array for IOCB_CMD_P{READ,WRITE}V.
+ *	aio_buf points at the array and aio_nbytes holds the number of
+ *	segments; ki_nbytes/ki_left are switched over to the byte count.
+ */
+static ssize_t aio_setup_vectored_rw(int type, struct kiocb *kiocb)
+{
+	struct iovec __user *uvector = (struct iovec __user *)kiocb->ki_buf;
+	unsigned long nr_segs = kiocb->ki_nbytes;
+	struct iovec *iov;
+	size_t tot_len = 0;
+	unsigned long seg;
+
+	if (nr_segs == 0 || nr_segs > UIO_MAXIOV)
+		return -EINVAL;
+
+	if (nr_segs == 1)
+		iov = &kiocb->ki_inline_vec;
+	else {
+		iov = kmalloc(nr_segs * sizeof(struct iovec), GFP_KERNEL);
+		if (!iov)
+			return -ENOMEM;
+	}
+	/* freed by really_put_req() from here on */
+	kiocb->ki_iovec = iov;
+
+	if (copy_from_user(iov, uvector, nr_segs * sizeof(*uvector)))
+		return -EFAULT;
+
+	/* same rules as do_readv_writev() */
+	for (seg = 0; seg < nr_segs; seg++) {
+		ssize_t len = (ssize_t)iov[seg].iov_len;
+
+		if (len < 0)
+			return -EINVAL;
+		if (unlikely(!access_ok(type == READ ? VERIFY_WRITE : VERIFY_READ,
+					iov[seg].iov_base, len)))
+			return -EFAULT;
+		tot_len += len;
+		if ((ssize_t)tot_len < 0)
+			return -EINVAL;
+	}
+
+	kiocb->ki_nr_segs = nr_segs;
+	kiocb->ki_cur_seg = 0;
+	kiocb->ki_nbytes = kiocb->ki_left = tot_len;
+	return 0;
+}
+
 /*
  * aio_setup_iocb:
  *	Performs the initial checks and aio retry method
@@ -1419,15 +1732,47 @@ static ssize_t aio_setup_iocb(struct kiocb *kiocb)
 		if (file->f_op->aio_write)
 			kiocb->ki_retry = aio_pwrite;
 		break;
+	case IOCB_CMD_PREADV:
+		ret = -EBADF;
+		if (unlikely(!(file->f_mode & FMODE_READ)))
+			break;
+		ret = aio_setup_vectored_rw(READ, kiocb);
+		if (unlikely(ret))
+			break;
+		ret = security_file_permission(file, MAY_READ);
+		if (unlikely(ret))
+			break;
+		ret = -EINVAL;
+		if (file->f_op->aio_readv)
+			kiocb->ki_retry = aio_rw_vect_retry;
+		break;
+	case IOCB_CMD_PWRITEV:
+		ret = -EBADF;
+		if (unlikely(!(file->f_mode & FMODE_WRITE)))
+			break;
+		ret = aio_setup_vectored_rw(WRITE, kiocb);
+		if (unlikely(ret))
+			break;
+		ret = security_file_permission(file, MAY_WRITE);
+		if (unlikely(ret))
+			break;
+		ret = -EINVAL;
+		if (file->f_op->aio_writev)
+			kiocb->ki_retry = aio_rw_vect_retry;
+		break;
 	case IOCB_CMD_FDSYNC:
 		ret = -EINVAL;
 		if (file->f_op->aio_fsync)
 			kiocb->ki_retry = aio_fdsync;
+		else if (file->f_op->fsync)
+			kiocb->ki_retry = aio_generic_fsync;
 		break;
 	case IOCB_CMD_FSYNC:
 		ret = -EINVAL;
 		if (file->f_op->aio_fsync)
 			kiocb->ki_retry = aio_fsync;
+		else if (file->f_op->fsync)
+			kiocb->ki_retry = aio_generic_fsync;
 		break;
 	default:
 		dprintk("EINVAL: io_submit: no operation provided\n");
@@ -1468,10 +1813,16 @@ static int aio_wake_function(wait_queue_t *wait, unsigned mode,
 	return 1;
 }
 
-int fastcall io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
-			 struct iocb *iocb)
+/*
+ * __io_submit_one:
+ *	Submit one iocb using a kiocb already obtained from aio_get_reqs().
+ *	*reqp is cleared once the kiocb has been consumed; if it is still
+ *	set on return the caller has to hand it back with aio_put_reqs().
+ */
+static int __io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
+			   struct iocb *iocb, struct kiocb **reqp)
 {
-	struct kiocb *req;
+	struct kiocb *req = *reqp;
 	struct file *file;
 	ssize_t ret;
 
@@ -1496,12 +1847,7 @@ int fastcall io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 	if (unlikely(!file))
 		return -EBADF;
 
-	req = aio_get_req(ctx);		/* returns with 2 references to req */
-	if (unlikely(!req)) {
-		fput(file);
-		return -EAGAIN;
-	}
-
+	*reqp = NULL;
 	req->ki_filp = file;
 	ret = put_user(req->ki_key, &user_iocb->aio_key);
 	if (unlikely(ret)) {
@@ -1542,6 +1888,44 @@ out_put_req:
 	return ret;
 }
 
+/* aio_put_reqs
+ *	Give back kiocbs from aio_get_reqs() that were never submitted.
+ *	NULL entries (already consumed) are skipped.
+ */
+static void aio_put_reqs(struct kioctx *ctx, struct kiocb **reqs, int nr)
+{
+	int i, put = 0;
+
+	spin_lock_irq(&ctx->ctx_lock);
+	for (i = 0; i < nr; i++) {
+		if (!reqs[i])
+			continue;
+		list_del(&reqs[i]->ki_list);
+		really_put_req(ctx, reqs[i]);
+		put++;
+	}
+	spin_unlock_irq(&ctx->ctx_lock);
+
+	while (put--)
+		put_ioctx(ctx);
+}
+
+int fastcall io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
+			 struct iocb *iocb)
+{
+	struct kiocb *req;
+	int ret;
+
+	req = aio_get_req(ctx);		/* returns with 2 references to req */
+	if (unlikely(!req))
+		return -EAGAIN;
+
+	ret = __io_submit_one(ctx, user_iocb, iocb, &req);
+	if (req)
+		aio_put_reqs(ctx, &req, 1);
+	return ret;
+}
+
 /* sys_io_submit:
  *	Queue the nr iocbs pointed to by iocbpp for processing.  Returns
  *	the number of iocbs queued.  May return -EINVAL if the aio_context
@@ -1558,7 +1942,9 @@ asmlinkage long sys_io_submit(aio_context_t ctx_id, long nr,
 			      struct iocb __user * __user *iocbpp)
 {
 	struct kioctx *ctx;
+	struct kiocb *reqs[AIO_SUBMIT_BATCH];
 	long ret = 0;
+	int nr_reqs = 0, next = 0;
 	int i;
 
 	if (unlikely(nr < 0))
@@ -1581,6 +1967,17 @@ asmlinkage long sys_io_submit(aio_context_t ctx_id, long nr,
 		struct iocb __user *user_iocb;
 		struct iocb tmp;
 
+		/* grab kiocbs and ring slots for the next batch in one go */
+		if (next == nr_reqs) {
+			nr_reqs = aio_get_reqs(ctx, reqs,
+					min_t(long, nr - i, AIO_SUBMIT_BATCH));
+			next = 0;
+			if (unlikely(!nr_reqs)) {
+				ret = -EAGAIN;
+				break;
+			}
+		}
+
 		if (unlikely(__get_user(user_iocb, iocbpp + i))) {
 			ret = -EFAULT;
 			break;
@@ -1591,11 +1988,15 @@ asmlinkage long sys_io_submit(aio_context_t ctx_id, long nr,
 			break;
 		}
 
-		ret = io_submit_one(ctx, user_iocb, &tmp);
+		ret = __io_submit_one(ctx, user_iocb, &tmp, &reqs[next]);
 		if (ret)
 			break;
+		next++;
 	}
 
+	if (next < nr_reqs)
+		aio_put_reqs(ctx, reqs + next, nr_reqs - next);
+
 	put_ioctx(ctx);
 	return i ? i : ret;
 }
@@ -1707,6 +2108,152 @@ asmlinkage long sys_io_getevents(aio_context_t ctx_id,
 	return ret;
 }
 
+/*
+ * Completion notification descriptors.
+ *
+ * sys_io_getfd() hands out a file that is linked to an aio context and
+ * polls readable whenever the completion ring holds events, so an event loop
+ * can wait for disk and network completions in the same poll()/select().
+ * The events themselves are still reaped from the ring, either with
+ * io_getevents() or directly from the mmapped aio_ring in user space by
+ * consuming entries between ring->head and ring->tail and advancing head.
+ */
+#define AIOFS_MAGIC	0xa10f5
+
+static unsigned aio_ring_pending(struct kioctx *ctx)
+{
+	struct aio_ring_info *info = &ctx->ring_info;
+	struct aio_ring *ring;
+	unsigned pending;
+
+	ring = kmap_atomic(info->ring_pages[0], KM_USER0);
+	/* head may be moved by user space; only trust it modulo nr */
+	pending = (ring->tail + info->nr - ring->head) % info->nr;
+	kunmap_atomic(ring, KM_USER0);
+	return pending;
+}
+
+static unsigned int aio_notify_poll(struct file *file, poll_table *wait)
+{
+	struct kioctx *ctx = file->private_data;
+	unsigned int mask = 0;
+
+	/* aio_complete() wakes ctx->wait after publishing the new tail */
+	poll_wait(file, &ctx->wait, wait);
+	if (aio_ring_pending(ctx))
+		mask |= POLLIN | POLLRDNORM;
+	if (ctx->dead)
+		mask |= POLLHUP;
+	return mask;
+}
+
+static int aio_notify_release(struct inode *inode, struct file *file)
+{
+	struct kioctx *ctx = file->private_data;
+
+	put_ioctx(ctx);
+	return 0;
+}
+
+static struct file_operations aio_notify_fops = {
+	.poll		= aio_notify_poll,
+	.release	= aio_notify_release,
+};
+
+static int aiofs_delete_dentry(struct dentry *dentry)
+{
+	return 1;
+}
+
+static struct dentry_operations aiofs_dentry_operations = {
+	.d_delete	= aiofs_delete_dentry,
+};
+
+static struct super_block *aiofs_get_sb(struct file_system_type *fs_type,
+		int flags, const char *dev_name, void *data)
+{
+	return get_sb_pseudo(fs_type, "aio:", NULL, AIOFS_MAGIC);
+}
+
+static struct file_system_type aio_fs_type = {
+	.name		= "aiofs",
+	.get_sb		= aiofs_get_sb,
+	.kill_sb	= kill_anon_super,
+};
+
+/* sys_io_getfd:
+ *	Return a new file descriptor that polls readable while the completion
+ *	ring of the aio context specified by ctx_id is not empty.  May fail
+ *	with -EINVAL if ctx_id is invalid, -EMFILE/-ENFILE if no descriptor or
+ *	file is available, or -ENOMEM.
+ */
+asmlinkage long sys_io_getfd(aio_context_t ctx_id)
+{
+	struct kioctx *ioctx;
+	struct file *file;
+	struct inode *inode;
+	struct dentry *dentry;
+	struct qstr this;
+	char name[32];
+	long ret;
+	int fd;
+
+	ioctx = lookup_ioctx(ctx_id);	/* the file keeps this reference */
+	if (unlikely(!ioctx))
+		return -EINVAL;
+
+	ret = fd = get_unused_fd();
+	if (fd < 0)
+		goto out_put_ioctx;
+
+	ret = -ENFILE;
+	file = get_empty_filp();
+	if (!file)
+		goto out_put_fd;
+
+	ret = -ENOMEM;
+	inode = new_inode(aio_mnt->mnt_sb);
+	if (!inode)
+		goto out_put_filp;
+	inode->i_mode = S_IRUSR | S_IWUSR;
+	inode->i_uid = current->fsuid;
+	inode->i_gid = current->fsgid;
+	inode->i_atime = inode->i_mtime = inode->i_ctime = CURRENT_TIME;
+
+	sprintf(name, "[%lu]", inode->i_ino);
+	this.name = name;
+	this.len = strlen(name);
+	this.hash = inode->i_ino;
+	dentry = d_alloc(aio_mnt->mnt_sb->s_root, &this);
+	if (!dentry)
+		goto out_iput;
+	dentry->d_op = &aiofs_dentry_operations;
+	d_add(dentry, inode);
+
+	file->f_vfsmnt = mntget(aio_mnt);
+	file->f_dentry = dentry;
+	file->f_mapping = inode->i_mapping;
+	file->f_pos = 0;
+	file->f_flags = O_RDONLY;
+	file->f_op = &aio_notify_fops;
+	file->f_mode = FMODE_READ;
+	file->f_version = 0;
+	file->private_data = ioctx;
+
+	fd_install(fd, file);
+	return fd;
+
+out_iput:
+	iput(inode);
+out_put_filp:
+	put_filp(file);
+out_put_fd:
+	put_unused_fd(fd);
+out_put_ioctx:
+	put_ioctx(ioctx);
+	return ret;
+}
+
 __initcall(aio_setup);
 
 EXPORT_SYMBOL(aio_complete);
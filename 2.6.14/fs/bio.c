@@ -437,17 +437,9 @@ static struct bio_map_data *bio_alloc_map_data(int nr_segs)
 	return NULL;
 }
 
-/**
- *	bio_uncopy_user	-	finish previously mapped bio
- *	@bio: bio being terminated
- *
- *	Free pages allocated from bio_copy_user() and write back data
- *	to user space in case of a read.
- */
-int bio_uncopy_user(struct bio *bio)
+static int __bio_uncopy_user(struct bio *bio, int copy_back)
 {
 	struct bio_map_data *bmd = bio->bi_private;
-	const int read = bio_data_dir(bio) == READ;
 	struct bio_vec *bvec;
 	int i, ret = 0;
 
@@ -455,7 +447,7 @@ int bio_uncopy_user(struct bio *bio)
 		char *addr = page_address(bvec->bv_page);
 		unsigned int len = bmd->iovecs[i].bv_len;
 
-		if (read && !ret && copy_to_user(bmd->userptr, addr, len))
+		if (copy_back && !ret && copy_to_user(bmd->userptr, addr, len))
 			ret = -EFAULT;
 
 		__free_page(bvec->bv_page);
@@ -466,6 +458,30 @@ int bio_uncopy_user(struct bio *bio)
 	return ret;
 }
 
+/**
+ *	bio_uncopy_user	-	finish previously mapped bio
+ *	@bio: bio being terminated
+ *
+ *	Free pages allocated from bio_copy_user() and write back data
+ *	to user space in case of a read.
+ */
+int bio_uncopy_user(struct bio *bio)
+{
+	return __bio_uncopy_user(bio, bio_data_dir(bio) == READ);
+}
+
+/**
+ *	bio_discard_copy_user	-	free a bio_copy_user() bio unused
+ *	@bio: bio that never went to the device
+ *
+ *	Like bio_uncopy_user(), but nothing is copied back to user space:
+ *	the kernel pages of a read hold no data.
+ */
+void bio_discard_copy_user(struct bio *bio)
+{
+	__bio_uncopy_user(bio, 0);
+}
+
 /**
  *	bio_copy_user	-	copy user data to bio
  *	@q: destination block queue
@@ -605,14 +621,13 @@ static struct bio *__bio_map_user_iov(request_queue_t *q,
 		const int local_nr_pages = end - start;
 		const int page_limit = cur_page + local_nr_pages;
 		
-		down_read(&current->mm->mmap_sem);
-		ret = get_user_pages(current, current->mm, uaddr,
-				     local_nr_pages,
-				     write_to_vm, 0, &pages[cur_page], NULL);
-		up_read(&current->mm->mmap_sem);
-
-		if (ret < local_nr_pages)
+		ret = get_user_pages_fast(uaddr, local_nr_pages, write_to_vm,
+					  &pages[cur_page]);
+		if (ret < local_nr_pages) {
+			if (ret >= 0)
+				ret = -EFAULT;
 			goto out_unmap;
+		}
 
 
 		offset = uaddr & ~PAGE_MASK;
@@ -1245,6 +1260,7 @@ EXPORT_SYMBOL(bio_split);
 EXPORT_SYMBOL(bio_split_pool);
 EXPORT_SYMBOL(bio_copy_user);
 EXPORT_SYMBOL(bio_uncopy_user);
+EXPORT_SYMBOL(bio_discard_copy_user);
 EXPORT_SYMBOL(bioset_create);
 EXPORT_SYMBOL(bioset_free);
 EXPORT_SYMBOL(bio_alloc_bioset);
@@ -23,6 +23,8 @@
 #include <linux/mount.h>
 #include <linux/uio.h>
 #include <linux/namei.h>
+#include <linux/aio.h>
+#include <linux/splice.h>
 #include <asm/uaccess.h>
 
 struct bdev_inode {
@@ -130,74 +132,345 @@ blkdev_get_block(struct inode *inode, sector_t iblock,
 	}
 	bh->b_bdev = I_BDEV(inode);
 	bh->b_blocknr = iblock;
+	/* File blocks are device blocks: map all that was asked for */
+	if (bh->b_size >> inode->i_blkbits > 1) {
+		sector_t nr = max_block(I_BDEV(inode)) - iblock;
+
+		if (nr < bh->b_size >> inode->i_blkbits)
+			bh->b_size = nr << inode->i_blkbits;
+	} else {
+		bh->b_size = 1 << inode->i_blkbits;
+	}
 	/*表明bh的b_bdev和b_blocknr是有效的*/
 	set_buffer_mapped(bh);
 	return 0;
 }
 
-static int
-blkdev_get_blocks(struct inode *inode, sector_t iblock,
-		unsigned long max_blocks, struct buffer_head *bh, int create)
-{
-	sector_t end_block = max_block(I_BDEV(inode));
-
-	if ((iblock + max_blocks) > end_block) {
-		max_blocks = end_block - iblock;
-		if ((long)max_blocks <= 0) {
-			if (create)
-				return -EIO;	/* write fully beyond EOF */
-			/*
-			 * It is a read which is fully beyond EOF.  We return
-			 * a !buffer_mapped buffer
-			 */
-			max_blocks = 0;
-		}
+/*
+ * O_DIRECT on a raw block device needs none of the get_block, boundary
+ * and zeroing machinery of fs/direct-io.c: file offsets are device
+ * offsets.  User pages are pinned and put straight into bios sized by
+ * bio_add_page() against the queue limits, and a single counter tracks
+ * the bios in flight.
+ */
+#define BLKDEV_DIO_PAGES	64
+
+struct blkdev_dio {
+	atomic_t		bio_count;	/* bios in flight, +1 for submitter */
+	int			rw;
+	int			error;
+	ssize_t			size;		/* bytes submitted */
+	struct kiocb		*iocb;
+	struct task_struct	*waiter;	/* NULL for async kiocbs */
+};
+
+static ssize_t blkdev_dio_result(struct blkdev_dio *dio)
+{
+	return dio->error ? dio->error : dio->size;
+}
+
+static int blkdev_dio_end_io(struct bio *bio, unsigned int bytes_done, int error)
+{
+	struct blkdev_dio *dio = bio->bi_private;
+	struct task_struct *waiter = dio->waiter;
+
+	if (bio->bi_size)
+		return 1;
+
+	if (!test_bit(BIO_UPTODATE, &bio->bi_flags))
+		dio->error = -EIO;
+
+	if (dio->rw == READ) {
+		bio_check_pages_dirty(bio);	/* transfers ownership */
+	} else {
+		struct bio_vec *bvec = bio->bi_io_vec;
+		int i;
+
+		for (i = 0; i < bio->bi_vcnt; i++)
+			page_cache_release(bvec[i].bv_page);
+		bio_put(bio);
 	}
 
-	bh->b_bdev = I_BDEV(inode);
-	bh->b_blocknr = iblock;
-	bh->b_size = max_blocks << inode->i_blkbits;
-	if (max_blocks)
-		set_buffer_mapped(bh);
+	if (atomic_dec_and_test(&dio->bio_count)) {
+		if (waiter) {
+			wake_up_process(waiter);
+		} else {
+			aio_complete(dio->iocb, blkdev_dio_result(dio), 0);
+			kfree(dio);
+		}
+	}
 	return 0;
 }
 
+static void blkdev_dio_submit(struct blkdev_dio *dio, struct bio *bio)
+{
+	atomic_inc(&dio->bio_count);
+	dio->size += bio->bi_size;
+	if (dio->rw == READ)
+		bio_set_pages_dirty(bio);
+	submit_bio(dio->rw, bio);
+}
+
+static struct bio *blkdev_dio_alloc(struct blkdev_dio *dio,
+				    struct block_device *bdev, loff_t pos)
+{
+	struct bio *bio;
+
+	bio = bio_alloc(GFP_KERNEL, bio_get_nr_vecs(bdev));
+	if (bio) {
+		bio->bi_bdev = bdev;
+		bio->bi_sector = pos >> 9;
+		bio->bi_end_io = blkdev_dio_end_io;
+		bio->bi_private = dio;
+	}
+	return bio;
+}
+
+/*
+ * No i_alloc_sem and no get_block calls: the device cannot grow or
+ * shrink block mappings under us.  generic_file_direct_IO() still
+ * writes back and invalidates the page cache around the transfer.
+ */
 static ssize_t
 blkdev_direct_IO(int rw, struct kiocb *iocb, const struct iovec *iov,
-			loff_t offset, unsigned long nr_segs)
+			loff_t pos, unsigned long nr_segs)
 {
-	struct file *file = iocb->ki_filp;
-	struct inode *inode = file->f_mapping->host;
+	struct inode *inode = iocb->ki_filp->f_mapping->host;
+	struct block_device *bdev = I_BDEV(inode);
+	unsigned int align = bdev_hardsect_size(bdev) - 1;
+	struct page *pages[BLKDEV_DIO_PAGES];
+	loff_t size = i_size_read(inode);
+	struct blkdev_dio *dio;
+	struct bio *bio = NULL;
+	unsigned long seg;
+	int error = 0;
+	ssize_t ret;
+
+	if (pos & align)
+		return -EINVAL;
+	for (seg = 0; seg < nr_segs; seg++) {
+		if (((unsigned long)iov[seg].iov_base & align) ||
+		    (iov[seg].iov_len & align))
+			return -EINVAL;
+	}
+	if (pos >= size)
+		return 0;
+
+	dio = kmalloc(sizeof(*dio), GFP_KERNEL);
+	if (!dio)
+		return -ENOMEM;
+	atomic_set(&dio->bio_count, 1);
+	dio->rw = rw;
+	dio->error = 0;
+	dio->size = 0;
+	dio->iocb = iocb;
+	dio->waiter = is_sync_kiocb(iocb) ? current : NULL;
+
+	for (seg = 0; seg < nr_segs && pos < size; seg++) {
+		unsigned long addr = (unsigned long)iov[seg].iov_base;
+		size_t len = min_t(loff_t, iov[seg].iov_len, size - pos);
+
+		while (len) {
+			unsigned int offset = addr & ~PAGE_MASK;
+			int nr_pages, pinned, i;
+
+			nr_pages = min_t(unsigned long, BLKDEV_DIO_PAGES,
+				(offset + len + PAGE_SIZE - 1) >> PAGE_SHIFT);
+			pinned = get_user_pages_fast(addr, nr_pages,
+						     rw == READ, pages);
+			if (pinned <= 0) {
+				error = pinned ? pinned : -EFAULT;
+				goto submitted;
+			}
+
+			for (i = 0; i < pinned; i++) {
+				unsigned int bytes = min_t(size_t, len,
+						PAGE_SIZE - offset);
+
+				if (!bio)
+					bio = blkdev_dio_alloc(dio, bdev, pos);
+				if (bio && bio_add_page(bio, pages[i], bytes,
+							offset) < bytes) {
+					/* queue limits reached, start a new bio */
+					blkdev_dio_submit(dio, bio);
+					bio = blkdev_dio_alloc(dio, bdev, pos);
+					if (bio && bio_add_page(bio, pages[i],
+							bytes, offset) < bytes) {
+						bio_put(bio);
+						bio = NULL;
+					}
+				}
+				if (!bio) {
+					while (i < pinned)
+						page_cache_release(pages[i++]);
+					error = -ENOMEM;
+					goto submitted;
+				}
+				addr += bytes;
+				pos += bytes;
+				len -= bytes;
+				offset = 0;
+			}
+		}
+	}
+
+submitted:
+	if (bio) {
+		if (bio->bi_size)
+			blkdev_dio_submit(dio, bio);
+		else
+			bio_put(bio);
+	}
+	/*
+	 * A short transfer is not an error.  Once bios are in flight,
+	 * dio->error belongs to blkdev_dio_end_io(), which may have recorded
+	 * an I/O error there already.
+	 */
+	if (!dio->size)
+		dio->error = error;
+
+	if (!dio->waiter) {
+		if (!atomic_dec_and_test(&dio->bio_count)) {
+			blk_run_address_space(inode->i_mapping);
+			return -EIOCBQUEUED;
+		}
+	} else if (!atomic_dec_and_test(&dio->bio_count)) {
+		blk_run_address_space(inode->i_mapping);
+		for (;;) {
+			set_current_state(TASK_UNINTERRUPTIBLE);
+			if (!atomic_read(&dio->bio_count))
+				break;
+			io_schedule();
+		}
+		__set_current_state(TASK_RUNNING);
+	}
 
-	return blockdev_direct_IO_no_locking(rw, iocb, inode, I_BDEV(inode),
-				iov, offset, nr_segs, blkdev_get_blocks, NULL);
+	ret = blkdev_dio_result(dio);
+	kfree(dio);
+	return ret;
 }
 
+/*
+ * Block device pages are read and written straight to BIOs through the
+ * mpage helpers, so page cache for a block device does not carry buffer
+ * heads unless someone asks for them through __getblk()/__bread(), or a
+ * partial write has to read in the rest of a page.  Pages which do have
+ * buffers keep going through the buffer-based paths.
+ */
 static int blkdev_writepage(struct page *page, struct writeback_control *wbc)
 {
+	int ret;
+
+	if (!page_has_buffers(page)) {
+		ret = mpage_writepage(page, blkdev_get_block, wbc);
+		if (ret != -EAGAIN)
+			return ret;
+		/* mpage could not handle it; the page is still locked */
+	}
 	return block_write_full_page(page, blkdev_get_block, wbc);
 }
 
+static int blkdev_writepages(struct address_space *mapping,
+			     struct writeback_control *wbc)
+{
+	return mpage_writepages(mapping, wbc, blkdev_get_block);
+}
+
 /*块设备文件的readpage方法，所有块设备文件的readpage方法都是相同的*/
 static int blkdev_readpage(struct file * file, struct page * page)
 {
-	return block_read_full_page(page, blkdev_get_block);
+	return mpage_readpage(page, blkdev_get_block);
+}
+
+static int blkdev_readpages(struct file *file, struct address_space *mapping,
+			    struct list_head *pages, unsigned nr_pages)
+{
+	return mpage_readpages(mapping, pages, nr_pages, blkdev_get_block);
 }
 
+/*
+ * A write covering the whole page, or landing in a page that is already
+ * uptodate, needs no buffers: commit_write just dirties the page.  Only
+ * partial writes into a !uptodate page fall back to block_prepare_write(),
+ * which reads the surrounding blocks through buffer heads.
+ */
 static int blkdev_prepare_write(struct file *file, struct page *page, unsigned from, unsigned to)
 {
+	if (PageUptodate(page) && !page_has_buffers(page))
+		return 0;
+	if (from == 0 && to == PAGE_CACHE_SIZE && !page_has_buffers(page))
+		return 0;
 	return block_prepare_write(page, from, to, blkdev_get_block);
 }
 
 static int blkdev_commit_write(struct file *file, struct page *page, unsigned from, unsigned to)
 {
-	return block_commit_write(page, from, to);
+	if (page_has_buffers(page))
+		return block_commit_write(page, from, to);
+
+	SetPageUptodate(page);
+	set_page_dirty(page);
+	return 0;
+}
+
+/*
+ * In a multi-page write only the first and last pages can be partial, so
+ * the pages in between all take the bufferless path above.
+ */
+static int blkdev_prepare_write_pages(struct file *file, struct page **pages,
+		unsigned nr, unsigned from, unsigned to)
+{
+	unsigned i;
+	int err;
+
+	for (i = 0; i < nr; i++) {
+		err = blkdev_prepare_write(file, pages[i], i ? 0 : from,
+				i == nr - 1 ? to : PAGE_CACHE_SIZE);
+		if (err)
+			return i ? i : err;
+	}
+	return nr;
+}
+
+/*
+ * Only the first @copied bytes are kept.  A page the copy stopped in is
+ * dropped unless it is uptodate: it may have taken the bufferless path,
+ * or have buffers that were never read.
+ */
+static int blkdev_commit_write_pages(struct file *file, struct page **pages,
+		unsigned nr, unsigned from, unsigned to, unsigned copied)
+{
+	unsigned end = from + copied;	/* offset from the first page */
+	unsigned committed = 0;
+	unsigned i;
+
+	for (i = 0; i < nr; i++) {
+		unsigned start = i << PAGE_CACHE_SHIFT;
+		unsigned f = i ? 0 : from;
+		unsigned t = i == nr - 1 ? to : PAGE_CACHE_SIZE;
+		unsigned e = t;
+
+		if (start + t > end) {
+			e = end > start + f ? end - start : f;
+			if (!PageUptodate(pages[i]))
+				e = f;
+		}
+		if (e <= f)
+			break;
+		blkdev_commit_write(file, pages[i], f, e);
+		committed = start + e - from;
+	}
+	return committed;
 }
 
 /*
  * private llseek:
  * for a block special file file->f_dentry->d_inode->i_size is zero
  * so we compute the size by hand (just as in block_read/write above)
+ *
+ * No i_sem here: i_size_read() is safe on its own, and taking the bdev
+ * inode's semaphore would serialize every lseek+write user of the device
+ * against each other, which the nolock write path below avoids.
  */
 static loff_t block_llseek(struct file *file, loff_t offset, int origin)
 {
@@ -205,7 +478,6 @@ static loff_t block_llseek(struct file *file, loff_t offset, int origin)
 	loff_t size;
 	loff_t retval;
 
-	down(&bd_inode->i_sem);
 	size = i_size_read(bd_inode);
 
 	switch (origin) {
@@ -222,7 +494,6 @@ static loff_t block_llseek(struct file *file, loff_t offset, int origin)
 		}
 		retval = offset;
 	}
-	up(&bd_inode->i_sem);
 	return retval;
 }
 	
@@ -772,6 +1043,15 @@ static int blkdev_close(struct inode * inode, struct file * filp)
 	return blkdev_put(bdev);
 }
 
+/*
+ * Buffered writes to a block device do not take the bdev inode's i_sem.
+ * A block device has no i_size changes or block allocation to protect,
+ * so the page locks taken by generic_file_buffered_write() are all the
+ * serialization needed.  A writer may hold several of them at once for
+ * ->prepare_write_pages, but always takes them in ascending index order,
+ * so overlapping writers cannot deadlock; they are merely ordered page by
+ * page.
+ */
 static ssize_t blkdev_file_write(struct file *file, const char __user *buf,
 				   size_t count, loff_t *ppos)
 {
@@ -788,6 +1068,12 @@ static ssize_t blkdev_file_aio_write(struct kiocb *iocb, const char __user *buf,
 	return generic_file_aio_write_nolock(iocb, &local_iov, 1, &iocb->ki_pos);
 }
 
+static ssize_t blkdev_file_aio_writev(struct kiocb *iocb,
+			const struct iovec *iov, unsigned long nr_segs, loff_t pos)
+{
+	return generic_file_aio_write_nolock(iocb, iov, nr_segs, &iocb->ki_pos);
+}
+
 static long block_ioctl(struct file *file, unsigned cmd, unsigned long arg)
 {
 	return blkdev_ioctl(file->f_mapping->host, file, cmd, arg);
@@ -795,11 +1081,14 @@ static long block_ioctl(struct file *file, unsigned cmd, unsigned long arg)
 
 struct address_space_operations def_blk_aops = {
 	.readpage	= blkdev_readpage,
+	.readpages	= blkdev_readpages,
 	.writepage	= blkdev_writepage,
 	.sync_page	= block_sync_page,
 	.prepare_write	= blkdev_prepare_write,
 	.commit_write	= blkdev_commit_write,
-	.writepages	= generic_writepages,
+	.prepare_write_pages = blkdev_prepare_write_pages,
+	.commit_write_pages = blkdev_commit_write_pages,
+	.writepages	= blkdev_writepages,
 	.direct_IO	= blkdev_direct_IO,
 };
 
@@ -811,6 +1100,8 @@ struct file_operations def_blk_fops = {
 	.write		= blkdev_file_write,
   	.aio_read	= generic_file_aio_read,
   	.aio_write	= blkdev_file_aio_write, 
+	.aio_readv	= generic_file_aio_readv,
+	.aio_writev	= blkdev_file_aio_writev,
 	.mmap		= generic_file_mmap,
 	.fsync		= block_fsync,
 	.unlocked_ioctl	= block_ioctl,
@@ -820,6 +1111,8 @@ struct file_operations def_blk_fops = {
 	.readv		= generic_file_readv,
 	.writev		= generic_file_write_nolock,
 	.sendfile	= generic_file_sendfile,
+	.splice_read	= generic_file_splice_read,
+	.splice_write	= generic_file_splice_write,
 };
 
 int ioctl_by_bdev(struct block_device *bdev, unsigned cmd, unsigned long arg)
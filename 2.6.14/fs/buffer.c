@@ -41,6 +41,7 @@
 #include <linux/bitops.h>
 #include <linux/mpage.h>
 #include <linux/bit_spinlock.h>
+#include <linux/workqueue.h>
 
 static int fsync_buffers_list(spinlock_t *lock, struct list_head *list);
 static void invalidate_bh_lrus(void);
@@ -278,12 +279,12 @@ void thaw_bdev(struct block_device *bdev, struct super_block *sb)
 EXPORT_SYMBOL(thaw_bdev);
 
 /*
- * sync everything.  Start out by waking pdflush, because that writes back
- * all queues in parallel.
+ * sync everything.  Start out by kicking the flusher threads, because they
+ * write back all queues in parallel.
  */
 static void do_sync(unsigned long wait)
 {
-	wakeup_pdflush(0);
+	wakeup_flusher_threads(0);
 	sync_inodes(0);		/* All mappings, inodes and their blockdevs */
 	DQUOT_SYNC(NULL);
 	sync_supers();		/* Write the superblocks */
@@ -302,9 +303,19 @@ asmlinkage long sys_sync(void)
 	return 0;
 }
 
+static void do_emergency_sync(void *unused)
+{
+	do_sync(0);
+}
+
+static DECLARE_WORK(emergency_sync_work, do_emergency_sync, NULL);
+
+/*
+ * Called from sysrq, so the sync itself is left to keventd.
+ */
 void emergency_sync(void)
 {
-	pdflush_operation(do_sync, 0);
+	schedule_work(&emergency_sync_work);
 }
 
 /*
@@ -388,6 +399,83 @@ asmlinkage long sys_fdatasync(unsigned int fd)
 	return do_fsync(fd, 1);
 }
 
+#define VALID_SYNC_FILE_RANGE_FLAGS	(SYNC_FILE_RANGE_WAIT_BEFORE |	\
+					 SYNC_FILE_RANGE_WRITE |	\
+					 SYNC_FILE_RANGE_WAIT_AFTER)
+
+/*
+ * sys_sync_file_range:
+ *	Write out and/or wait upon the data pages in [offset, offset+nbytes)
+ *	of a file; nbytes == 0 means "to the end of the file".  Only data is
+ *	covered: neither the inode nor the disk write cache is flushed, so
+ *	this is a tool for controlling writeout, not a replacement for
+ *	fdatasync().
+ */
+asmlinkage long sys_sync_file_range(int fd, loff_t offset, loff_t nbytes,
+				    unsigned int flags)
+{
+	struct file *file;
+	struct address_space *mapping;
+	loff_t endbyte;
+	umode_t i_mode;
+	int ret, fput_needed;
+
+	ret = -EINVAL;
+	if (flags & ~VALID_SYNC_FILE_RANGE_FLAGS)
+		goto out;
+
+	endbyte = offset + nbytes;
+	if ((s64)offset < 0)
+		goto out;
+	if ((s64)endbyte < 0)
+		goto out;
+	if (endbyte < offset)
+		goto out;
+
+	if (sizeof(pgoff_t) == 4) {
+		if (offset >= (0x100000000ULL << PAGE_CACHE_SHIFT)) {
+			/*
+			 * The range starts outside a 32 bit machine's
+			 * pagecache addressing capabilities.  Let it "succeed"
+			 */
+			ret = 0;
+			goto out;
+		}
+		if (endbyte >= (0x100000000ULL << PAGE_CACHE_SHIFT)) {
+			/*
+			 * Out to EOF
+			 */
+			nbytes = 0;
+		}
+	}
+
+	if (nbytes == 0)
+		endbyte = LLONG_MAX;
+	else
+		endbyte--;		/* inclusive */
+
+	ret = -EBADF;
+	file = fget_light(fd, &fput_needed);
+	if (!file)
+		goto out;
+
+	i_mode = file->f_dentry->d_inode->i_mode;
+	ret = -ESPIPE;
+	if (!S_ISREG(i_mode) && !S_ISBLK(i_mode) && !S_ISDIR(i_mode) &&
+			!S_ISLNK(i_mode))
+		goto out_put;
+
+	mapping = file->f_mapping;
+	ret = 0;
+	if (mapping_cap_writeback_dirty(mapping) && mapping->nrpages)
+		ret = do_sync_mapping_range(mapping, offset, endbyte, flags);
+
+out_put:
+	fput_light(file, fput_needed);
+out:
+	return ret;
+}
+
 /*
  * Various filesystems appear to want __find_get_block to be non-blocking.
  * But it's the page lock which protects the buffers.  To get around this,
@@ -499,16 +587,16 @@ void invalidate_bdev(struct block_device *bdev, int destroy_dirty_buffers)
 }
 
 /*
- * Kick pdflush then try to free up some ZONE_NORMAL memory.
+ * Kick the flusher threads then try to free up some ZONE_NORMAL memory.
  */
 static void free_more_memory(void)
 {
 	struct zone **zones;
 	pg_data_t *pgdat;
 
-	/*唤醒一个pdflush线程，触发高速缓存中1024个脏页的写操作*/
-	wakeup_pdflush(1024);
-	/*让出处理器，给pdflush线程执行提供机会*/
+	/*唤醒各设备的flusher线程，触发高速缓存中1024个脏页的写操作*/
+	wakeup_flusher_threads(1024);
+	/*让出处理器，给flusher线程执行提供机会*/
 	yield();
 
 	for_each_pgdat(pgdat) {
@@ -876,8 +964,11 @@ int __set_page_dirty_buffers(struct page *page)
 	if (!TestSetPageDirty(page)) {
 		write_lock_irq(&mapping->tree_lock);
 		if (page->mapping) {	/* Race with truncate? */
-			if (mapping_cap_account_dirty(mapping))
-				inc_page_state(nr_dirty);
+			if (mapping_cap_account_dirty(mapping)) {
+				__inc_zone_page_state(page, NR_FILE_DIRTY);
+				inc_bdi_stat(mapping->backing_dev_info,
+						BDI_RECLAIMABLE);
+			}
 			radix_tree_tag_set(&mapping->page_tree,
 						page_index(page),
 						PAGECACHE_TAG_DIRTY);
@@ -1101,6 +1192,11 @@ link_dev_buffers(struct page *page, struct buffer_head *head)
 
 /*
  * Initialise the state of a blockdev page's buffers.
+ *
+ * The page may have been dirtied by a bufferless write (see
+ * blkdev_commit_write()).  Its new buffers then have to be dirty too, or
+ * block_write_full_page() would find nothing to write and lose the data.
+ * The caller holds the page lock, which keeps writeback away meanwhile.
  */ 
 static void
 init_page_buffers(struct page *page, struct block_device *bdev,
@@ -1109,6 +1205,7 @@ init_page_buffers(struct page *page, struct block_device *bdev,
 	struct buffer_head *head = page_buffers(page);
 	struct buffer_head *bh = head;
 	int uptodate = PageUptodate(page);
+	int dirty = PageDirty(page);
 
 	do {
 		if (!buffer_mapped(bh)) {
@@ -1117,6 +1214,8 @@ init_page_buffers(struct page *page, struct block_device *bdev,
 			bh->b_blocknr = block;
 			if (uptodate)
 				set_buffer_uptodate(bh);
+			if (dirty)
+				set_buffer_dirty(bh);
 			set_buffer_mapped(bh);
 		}
 		/*
@@ -1962,9 +2061,15 @@ recover:
 	} while (bh != head);
 	goto done;
 }
-/*为page准备bh*/
+/*
+ * 为page准备bh
+ *
+ * With @keep_new, newly allocated buffers are left BH_New for the caller,
+ * which then has to clear it: see generic_commit_write_pages().
+ */
 static int __block_prepare_write(struct inode *inode, struct page *page,
-		unsigned from, unsigned to, get_block_t *get_block)
+		unsigned from, unsigned to, get_block_t *get_block,
+		int keep_new)
 {
 	unsigned block_start, block_end;
 	sector_t block;
@@ -2053,6 +2158,8 @@ static int __block_prepare_write(struct inode *inode, struct page *page,
 			err = -EIO;
 	}
 	if (!err) {
+		if (keep_new)
+			return 0;
 		bh = head;
 		do {
 			if (buffer_new(bh))
@@ -2339,7 +2446,7 @@ int cont_prepare_write(struct page *page, unsigned offset,
 			(*bytes)++;
 		}
 		status = __block_prepare_write(inode, new_page, zerofrom,
-						PAGE_CACHE_SIZE, get_block);
+						PAGE_CACHE_SIZE, get_block, 0);
 		if (status)
 			goto out_unmap;
 		kaddr = kmap_atomic(new_page, KM_USER0);
@@ -2368,7 +2475,7 @@ int cont_prepare_write(struct page *page, unsigned offset,
 		if (offset <= zerofrom)
 			zerofrom = offset;
 	}
-	status = __block_prepare_write(inode, page, zerofrom, to, get_block);
+	status = __block_prepare_write(inode, page, zerofrom, to, get_block, 0);
 	if (status)
 		goto out1;
 	if (zerofrom < offset) {
@@ -2396,7 +2503,7 @@ int block_prepare_write(struct page *page, unsigned from, unsigned to,
 {
 	struct inode *inode = page->mapping->host;
 	/*为page准备bh*/
-	int err = __block_prepare_write(inode, page, from, to, get_block);
+	int err = __block_prepare_write(inode, page, from, to, get_block, 0);
 	if (err)
 		ClearPageUptodate(page);
 	return err;
@@ -2430,6 +2537,170 @@ int generic_commit_write(struct file *file, struct page *page,
 	return 0;
 }
 
+/*
+ * Map the buffers of @pages that already have blocks on disk, asking
+ * get_block for the rest of the range each time so that a filesystem
+ * returning multi-block mappings needs only a call per extent.  Only
+ * blocks inside i_size are looked up: past it everything is a hole, and
+ * __block_prepare_write() allocates those.
+ */
+static void block_map_pages(struct inode *inode, struct page **pages,
+		unsigned nr, get_block_t *get_block)
+{
+	const unsigned blkbits = inode->i_blkbits;
+	const unsigned blocksize = 1 << blkbits;
+	sector_t block = (sector_t)pages[0]->index <<
+					(PAGE_CACHE_SHIFT - blkbits);
+	sector_t last_block;
+	sector_t map_start = 0, map_end = 0;	/* what map_bh covers */
+	struct buffer_head map_bh;
+	unsigned i;
+
+	last_block = (i_size_read(inode) + blocksize - 1) >> blkbits;
+	if (last_block > block + (nr << (PAGE_CACHE_SHIFT - blkbits)))
+		last_block = block + (nr << (PAGE_CACHE_SHIFT - blkbits));
+
+	for (i = 0; i < nr && block < last_block; i++) {
+		struct buffer_head *bh, *head;
+
+		if (!page_has_buffers(pages[i]))
+			create_empty_buffers(pages[i], blocksize, 0);
+		bh = head = page_buffers(pages[i]);
+		do {
+			if (block >= last_block)
+				break;
+			if (buffer_mapped(bh))
+				continue;
+			if (block >= map_end) {
+				map_bh.b_state = 0;
+				map_bh.b_size = (last_block - block) << blkbits;
+				if (get_block(inode, block, &map_bh, 0))
+					return;
+				map_start = block;
+				map_end = block + 1;
+				if (buffer_mapped(&map_bh))
+					map_end = block + (map_bh.b_size >> blkbits);
+			}
+			if (buffer_mapped(&map_bh)) {
+				bh->b_bdev = map_bh.b_bdev;
+				bh->b_blocknr = map_bh.b_blocknr +
+						(block - map_start);
+				set_buffer_mapped(bh);
+			}
+		} while (block++, (bh = bh->b_this_page) != head);
+	}
+}
+
+/*
+ * ->prepare_write_pages for get_block based filesystems.  If one of the
+ * pages fails, the ones before it are still returned as prepared, and the
+ * error is left for the next write to run into; it has cleaned up the
+ * failing page as block_prepare_write() would.
+ *
+ * Newly allocated buffers stay BH_New until generic_commit_write_pages(),
+ * which zeroes any that the copy did not reach.
+ */
+int block_prepare_write_pages(struct page **pages, unsigned nr,
+		unsigned from, unsigned to, get_block_t *get_block)
+{
+	struct inode *inode = pages[0]->mapping->host;
+	unsigned i;
+	int err;
+
+	block_map_pages(inode, pages, nr, get_block);
+	for (i = 0; i < nr; i++) {
+		err = __block_prepare_write(inode, pages[i], i ? 0 : from,
+				i == nr - 1 ? to : PAGE_CACHE_SIZE, get_block, 1);
+		if (err) {
+			ClearPageUptodate(pages[i]);
+			return i ? i : err;
+		}
+	}
+	return nr;
+}
+
+/*
+ * Zero what the write did not reach, [from, to), of the buffers newly
+ * allocated in @page, so that they cannot expose stale disk contents, and
+ * clear BH_New on all of them.
+ */
+static void block_zero_new_buffers(struct page *page, unsigned from,
+		unsigned to)
+{
+	unsigned block_start = 0, block_end;
+	struct buffer_head *head, *bh;
+
+	bh = head = page_buffers(page);
+	do {
+		block_end = block_start + bh->b_size;
+		if (buffer_new(bh)) {
+			if (block_end > from && block_start < to) {
+				if (!PageUptodate(page)) {
+					unsigned start = max(from, block_start);
+					unsigned end = min(to, block_end);
+					void *kaddr;
+
+					kaddr = kmap_atomic(page, KM_USER0);
+					memset(kaddr + start, 0, end - start);
+					flush_dcache_page(page);
+					kunmap_atomic(kaddr, KM_USER0);
+					set_buffer_uptodate(bh);
+				}
+				mark_buffer_dirty(bh);
+			}
+			clear_buffer_new(bh);
+		}
+		block_start = block_end;
+	} while ((bh = bh->b_this_page) != head);
+}
+
+/*
+ * ->commit_write_pages to go with block_prepare_write_pages(): dirties the
+ * written buffers and extends i_size once for the lot.
+ *
+ * Only the first @copied bytes from @from were filled in.  Where the copy
+ * stopped inside a page that is not uptodate, the buffers there may never
+ * have been read, so nothing of that page is kept.  Returns the number of
+ * bytes committed.
+ */
+int generic_commit_write_pages(struct file *file, struct page **pages,
+		unsigned nr, unsigned from, unsigned to, unsigned copied)
+{
+	struct inode *inode = pages[0]->mapping->host;
+	unsigned end = from + copied;	/* offset from the first page */
+	unsigned committed = 0;
+	loff_t pos;
+	unsigned i;
+
+	for (i = 0; i < nr; i++) {
+		struct page *page = pages[i];
+		unsigned start = i << PAGE_CACHE_SHIFT;
+		unsigned f = i ? 0 : from;
+		unsigned t = i == nr - 1 ? to : PAGE_CACHE_SIZE;
+		unsigned e = t;
+
+		if (start + t > end) {
+			e = end > start + f ? end - start : f;
+			if (!PageUptodate(page))
+				e = f;
+		}
+		/* Before the commit, which may make the page uptodate */
+		block_zero_new_buffers(page, e, t);
+		if (e > f) {
+			__block_commit_write(inode, page, f, e);
+			committed = start + e - from;
+		}
+	}
+
+	/* i_sem is held, as in generic_commit_write() */
+	pos = ((loff_t)pages[0]->index << PAGE_CACHE_SHIFT) + from + committed;
+	if (committed && pos > inode->i_size) {
+		i_size_write(inode, pos);
+		mark_inode_dirty(inode);
+	}
+	return committed;
+}
+
 
 /*
  * nobh_prepare_write()'s prereads are special: the buffer_heads are freed
@@ -2492,6 +2763,7 @@ int nobh_prepare_write(struct page *page, unsigned from, unsigned to,
 		int create;
 
 		map_bh.b_state = 0;
+		map_bh.b_size = blocksize;
 		create = 1;
 		if (block_start >= to)
 			create = 0;
@@ -2841,6 +3113,7 @@ sector_t generic_block_bmap(struct address_space *mapping, sector_t block,
 	struct inode *inode = mapping->host;
 	tmp.b_state = 0;
 	tmp.b_blocknr = 0;
+	tmp.b_size = 1 << inode->i_blkbits;
 	get_block(inode, block, &tmp, 0);
 	return tmp.b_blocknr;
 }
@@ -3129,7 +3402,7 @@ int block_sync_page(struct page *page)
  * still running obsolete flush daemons, so we terminate them here.
  *
  * Use of bdflush() is deprecated and will be removed in a future kernel.
- * The `pdflush' kernel threads fully replace bdflush daemons and this call.
+ * The per-device flusher threads fully replace bdflush daemons and this call.
  */
 asmlinkage long sys_bdflush(int func, long data)
 {
@@ -3263,6 +3536,7 @@ EXPORT_SYMBOL(__brelse);
 EXPORT_SYMBOL(__wait_on_buffer);
 EXPORT_SYMBOL(block_commit_write);
 EXPORT_SYMBOL(block_prepare_write);
+EXPORT_SYMBOL(block_prepare_write_pages);
 EXPORT_SYMBOL(block_read_full_page);
 EXPORT_SYMBOL(block_sync_page);
 EXPORT_SYMBOL(block_truncate_page);
@@ -3275,6 +3549,7 @@ EXPORT_SYMBOL(file_fsync);
 EXPORT_SYMBOL(fsync_bdev);
 EXPORT_SYMBOL(generic_block_bmap);
 EXPORT_SYMBOL(generic_commit_write);
+EXPORT_SYMBOL(generic_commit_write_pages);
 EXPORT_SYMBOL(generic_cont_expand);
 EXPORT_SYMBOL(init_buffer);
 EXPORT_SYMBOL(invalidate_bdev);
@@ -16,14 +16,53 @@
 #include <linux/kernel.h>
 #include <linux/spinlock.h>
 #include <linux/sched.h>
+#include <linux/slab.h>
 #include <linux/fs.h>
 #include <linux/mm.h>
 #include <linux/writeback.h>
 #include <linux/blkdev.h>
 #include <linux/backing-dev.h>
 #include <linux/buffer_head.h>
+#include <linux/kthread.h>
+#include <linux/cpuset.h>
+#include <linux/completion.h>
+#include <linux/rwsem.h>
 
-extern struct super_block *blockdev_superblock;
+/*
+ * The maximum number of pages to writeout in a single background or kupdate
+ * pass.  We do this so we don't hold I_LOCK against an inode for
+ * enormous amounts of time, which would block a userspace task which has
+ * been forced to throttle against that inode.  Also, the code reevaluates
+ * the dirty each time it has written this many pages.
+ */
+#define MAX_WRITEBACK_PAGES	1024
+
+/*
+ * What a flusher is asked to do by wb_writeback().
+ */
+struct wb_writeback_args {
+	long nr_pages;			/* pages still to write */
+	struct super_block *sb;		/* only this sb's inodes, or NULL */
+	enum writeback_sync_modes sync_mode;
+	unsigned for_kupdate:1;		/* only inodes dirtied long ago */
+	unsigned for_background:1;	/* stop below the background limit */
+};
+
+/*
+ * A writeback request queued on backing_dev_info.work_list.  If somebody
+ * waits for it, it lives on their stack and @done is completed; otherwise
+ * the flusher frees it.
+ */
+struct bdi_work {
+	struct list_head list;
+	struct wb_writeback_args args;
+	struct completion *done;
+};
+
+static inline struct backing_dev_info *inode_bdi(struct inode *inode)
+{
+	return inode->i_mapping->backing_dev_info;
+}
 
 /**
  *	__mark_inode_dirty -	internal function
@@ -32,7 +71,7 @@ extern struct super_block *blockdev_superblock;
  *	Mark an inode as dirty. Callers should use mark_inode_dirty or
  *  	mark_inode_dirty_sync.
  *
- * Put the inode on the super block's dirty list.
+ * Put the inode on its backing device's dirty list.
  *
  * CAREFUL! We mark it dirty unconditionally, but move it onto the
  * dirty list only if it is hashed or if it refers to a blockdev.
@@ -55,6 +94,7 @@ extern struct super_block *blockdev_superblock;
 void __mark_inode_dirty(struct inode *inode, int flags)
 {
 	struct super_block *sb = inode->i_sb;
+	struct backing_dev_info *bdi;
 
 	/*
 	 * Don't do this for I_DIRTY_PAGES - that doesn't actually
@@ -108,8 +148,8 @@ void __mark_inode_dirty(struct inode *inode, int flags)
 			goto out;
 
 		/*
-		 * Only add valid (hashed) inodes to the superblock's
-		 * dirty list.  Add blockdev inodes as well.
+		 * Only add valid (hashed) inodes to the dirty list.  Add
+		 * blockdev inodes as well.
 		 */
 		if (!S_ISBLK(inode->i_mode)) {
 			if (hlist_unhashed(&inode->i_hash))
@@ -119,12 +159,17 @@ void __mark_inode_dirty(struct inode *inode, int flags)
 			goto out;
 
 		/*
-		 * If the inode was already on s_dirty or s_io, don't
-		 * reposition it (that would break s_dirty time-ordering).
+		 * If the inode was already on b_dirty or b_io, don't
+		 * reposition it (that would break b_dirty time-ordering).
+		 * A device without a flusher gets one for its first dirty
+		 * inode.
 		 */
 		if (!was_dirty) {
+			bdi = inode_bdi(inode);
 			inode->dirtied_when = jiffies;
-			list_move(&inode->i_list, &sb->s_dirty);
+			list_move(&inode->i_list, &bdi->b_dirty);
+			if (!bdi->wb_task && bdi_cap_writeback_dirty(bdi))
+				bdi_kick_forker();
 		}
 	}
 out:
@@ -155,7 +200,6 @@ __sync_single_inode(struct inode *inode, struct writeback_control *wbc)
 {
 	unsigned dirty;
 	struct address_space *mapping = inode->i_mapping;
-	struct super_block *sb = inode->i_sb;
 	int wait = wbc->sync_mode == WB_SYNC_ALL;
 	int ret;
 
@@ -192,35 +236,37 @@ __sync_single_inode(struct inode *inode, struct writeback_control *wbc)
 			/*
 			 * We didn't write back all the pages.  nfs_writepages()
 			 * sometimes bales out without doing anything. Redirty
-			 * the inode.  It is still on sb->s_io.
+			 * the inode.  It is still on bdi->b_io.
 			 */
 			if (wbc->for_kupdate) {
 				/*
 				 * For the kupdate function we leave the inode
-				 * at the head of sb_dirty so it will get more
+				 * at the head of b_dirty so it will get more
 				 * writeout as soon as the queue becomes
 				 * uncongested.
 				 */
 				inode->i_state |= I_DIRTY_PAGES;
-				list_move_tail(&inode->i_list, &sb->s_dirty);
+				list_move_tail(&inode->i_list,
+					       &inode_bdi(inode)->b_dirty);
 			} else {
 				/*
 				 * Otherwise fully redirty the inode so that
-				 * other inodes on this superblock will get some
+				 * other inodes on this device will get some
 				 * writeout.  Otherwise heavy writing to one
 				 * file would indefinitely suspend writeout of
 				 * all the other files.
 				 */
 				inode->i_state |= I_DIRTY_PAGES;
 				inode->dirtied_when = jiffies;
-				list_move(&inode->i_list, &sb->s_dirty);
+				list_move(&inode->i_list,
+					  &inode_bdi(inode)->b_dirty);
 			}
 		} else if (inode->i_state & I_DIRTY) {
 			/*
 			 * Someone redirtied the inode while were writing back
 			 * the pages.
 			 */
-			list_move(&inode->i_list, &sb->s_dirty);
+			list_move(&inode->i_list, &inode_bdi(inode)->b_dirty);
 		} else if (atomic_read(&inode->i_count)) {
 			/*
 			 * The inode is clean, inuse
@@ -254,7 +300,7 @@ __writeback_single_inode(struct inode *inode, struct writeback_control *wbc)
 
 	/*如果inode已经被锁定，而！WB_SYNC_ALL表示不会阻塞，因此直接退出???*/
 	if ((wbc->sync_mode != WB_SYNC_ALL) && (inode->i_state & I_LOCK)) {
-		list_move(&inode->i_list, &inode->i_sb->s_dirty);
+		list_move(&inode->i_list, &inode_bdi(inode)->b_dirty);
 		return 0;
 	}
 
@@ -277,84 +323,79 @@ __writeback_single_inode(struct inode *inode, struct writeback_control *wbc)
 }
 
 /*
- * Write out a superblock's list of dirty inodes.  A wait will be performed
+ * Take a reference on @sb and its s_umount for the flusher, unless it is
+ * being mounted or unmounted.  Called under inode_lock.
+ */
+static int pin_sb_for_writeback(struct super_block *sb)
+{
+	spin_lock(&sb_lock);
+	sb->s_count++;
+	if (down_read_trylock(&sb->s_umount)) {
+		if (sb->s_root) {
+			spin_unlock(&sb_lock);
+			return 1;
+		}
+		up_read(&sb->s_umount);
+	}
+	__put_super(sb);
+	spin_unlock(&sb_lock);
+	return 0;
+}
+
+/*
+ * Write out a device's list of dirty inodes.  A wait will be performed
  * upon no inodes, all inodes or the final one, depending upon sync_mode.
  *
  * If older_than_this is non-NULL, then only write out inodes which
  * had their first dirtying at a time earlier than *older_than_this.
  *
- * If we're a pdlfush thread, then implement pdflush collision avoidance
- * against the entire list.
+ * If `only_sb' is non-NULL then only that superblock's inodes are written,
+ * and the caller holds its s_umount.  Otherwise the device's inodes may
+ * belong to several superblocks (a filesystem and the blockdev inodes of
+ * its disk, say), and each is pinned here while its inodes are written.
  *
- * WB_SYNC_HOLD is a hack for sys_sync(): reattach the inode to sb->s_dirty so
- * that it can be located for waiting on in __writeback_single_inode().
+ * WB_SYNC_HOLD is a hack for sys_sync(): reattach the inode to bdi->b_dirty
+ * so that it can be located for waiting on in __writeback_single_inode().
  *
  * Called under inode_lock.
  *
- * If `bdi' is non-zero then we're being asked to writeback a specific queue.
- * This function assumes that the blockdev superblock's inodes are backed by
- * a variety of queues, so all inodes are searched.  For other superblocks,
- * assume that all inodes are backed by the same queue.
- *
- * FIXME: this linear search could get expensive with many fileystems.  But
- * how to fix?  We need to go from an address_space to all inodes which share
- * a queue with that address_space.  (Easy: have a global "dirty superblocks"
- * list).
- *
- * The inodes to be written are parked on sb->s_io.  They are moved back onto
- * sb->s_dirty as they are selected for writing.  This way, none can be missed
- * on the writer throttling path, and we get decent balancing between many
- * throttled threads: we don't want them all piling up on __wait_on_inode.
+ * The inodes to be written are parked on bdi->b_io.  They are moved back onto
+ * bdi->b_dirty as they are selected for writing.  This way, none can be
+ * missed, and heavy redirtying of one inode cannot starve the others.
  */
 static void
-sync_sb_inodes(struct super_block *sb, struct writeback_control *wbc)
+writeback_bdi_inodes(struct backing_dev_info *bdi,
+		     struct writeback_control *wbc, struct super_block *only_sb)
 {
 	const unsigned long start = jiffies;	/* livelock avoidance */
+	struct super_block *pinned = NULL;
+	LIST_HEAD(other_sbs);
+
+	if (!bdi_cap_writeback_dirty(bdi))
+		return;
 
-	/*把脏inode链表s_dirty插入到待传输到磁盘的inode链表s_io,并清空s_dirty链表*/
-	if (!wbc->for_kupdate || list_empty(&sb->s_io))
-		list_splice_init(&sb->s_dirty, &sb->s_io);
-	/*遍历sb->s_io中的每一个inode*/
-	while (!list_empty(&sb->s_io)) {
-		struct inode *inode = list_entry(sb->s_io.prev,
+	/*把脏inode链表b_dirty插入到待传输到磁盘的inode链表b_io,并清空b_dirty链表*/
+	if (!wbc->for_kupdate || list_empty(&bdi->b_io))
+		list_splice_init(&bdi->b_dirty, &bdi->b_io);
+	/*遍历bdi->b_io中的每一个inode*/
+	while (!list_empty(&bdi->b_io)) {
+		struct inode *inode = list_entry(bdi->b_io.prev,
 						struct inode, i_list);
-		struct address_space *mapping = inode->i_mapping;
-		struct backing_dev_info *bdi = mapping->backing_dev_info;
+		struct super_block *sb = inode->i_sb;
 		long pages_skipped;
 
-		if (!bdi_cap_writeback_dirty(bdi)) {
-			list_move(&inode->i_list, &sb->s_dirty);
-			if (sb == blockdev_superblock) {
-				/*
-				 * Dirty memory-backed blockdev: the ramdisk
-				 * driver does this.  Skip just this inode
-				 */
-				continue;
-			}
-			/*
-			 * Dirty memory-backed inode against a filesystem other
-			 * than the kernel-internal bdev filesystem.  Skip the
-			 * entire superblock.
-			 */
-			break;
+		if (only_sb && sb != only_sb) {
+			/* Keeps its place, for whoever writes that sb */
+			list_move(&inode->i_list, &other_sbs);
+			continue;
 		}
 
 		if (wbc->nonblocking && bdi_write_congested(bdi)) {
 			wbc->encountered_congestion = 1;
-			if (sb != blockdev_superblock)
-				break;		/* Skip a congested fs */
-			list_move(&inode->i_list, &sb->s_dirty);
-			continue;		/* Skip a congested blockdev */
+			break;		/* Skip a congested device */
 		}
 
-		if (wbc->bdi && bdi != wbc->bdi) {
-			if (sb != blockdev_superblock)
-				break;		/* fs has the wrong queue */
-			list_move(&inode->i_list, &sb->s_dirty);
-			continue;		/* blockdev has wrong queue */
-		}
-
-		/* Was this inode dirtied after sync_sb_inodes was called? */
+		/* Was this inode dirtied after writeback_bdi_inodes was called? */
 		if (time_after(inode->dirtied_when, start))
 			break;
 
@@ -363,10 +404,17 @@ sync_sb_inodes(struct super_block *sb, struct writeback_control *wbc)
 						*wbc->older_than_this))
 			break;
 
-		/* Is another pdflush already flushing this queue? */
-		/*同一个请求队列上不允许有多个pdflush内核线程*/
-		if (current_is_pdflush() && !writeback_acquire(bdi))
-			break;
+		if (!only_sb && sb != pinned) {
+			if (pinned)
+				drop_super(pinned);
+			pinned = NULL;
+			if (!pin_sb_for_writeback(sb)) {
+				/* Being (un)mounted: leave it to the mounter */
+				list_move(&inode->i_list, &bdi->b_dirty);
+				continue;
+			}
+			pinned = sb;
+		}
 
 		BUG_ON(inode->i_state & I_FREEING);
 		__iget(inode);
@@ -375,17 +423,15 @@ sync_sb_inodes(struct super_block *sb, struct writeback_control *wbc)
 		__writeback_single_inode(inode, wbc);
 		if (wbc->sync_mode == WB_SYNC_HOLD) {
 			inode->dirtied_when = jiffies;
-			list_move(&inode->i_list, &sb->s_dirty);
+			list_move(&inode->i_list, &bdi->b_dirty);
 		}
-		if (current_is_pdflush())
-			writeback_release(bdi);
-		/*如果略过了刚处理的索引节点中的一些页，将重新放回s_dirty链表*/
+		/*如果略过了刚处理的索引节点中的一些页，将重新放回b_dirty链表*/
 		if (wbc->pages_skipped != pages_skipped) {
 			/*
 			 * writeback is not making progress due to locked
 			 * buffers.  Skip this inode for now.
 			 */
-			list_move(&inode->i_list, &sb->s_dirty);
+			list_move(&inode->i_list, &bdi->b_dirty);
 		}
 		spin_unlock(&inode_lock);
 		cond_resched();
@@ -395,72 +441,302 @@ sync_sb_inodes(struct super_block *sb, struct writeback_control *wbc)
 		if (wbc->nr_to_write <= 0)
 			break;
 	}
-	return;		/* Leave any unwritten inodes on s_io */
+	if (pinned)
+		drop_super(pinned);
+	/* The skipped inodes are the oldest ones: back at the tail of b_io */
+	if (!list_empty(&other_sbs))
+		list_splice(&other_sbs, bdi->b_io.prev);
+	return;		/* Leave any unwritten inodes on b_io */
 }
 
 /*
- * Start writeback of dirty pagecache data against all unlocked inodes.
- *
- * Note:
- * We don't need to grab a reference to superblock here. If it has non-empty
- * ->s_dirty it's hadn't been killed yet and kill_super() won't proceed
- * past sync_inodes_sb() until both the ->s_dirty and ->s_io lists are
- * empty. Since __sync_single_inode() regains inode_lock before it finally moves
- * inode from superblock lists we are OK.
- *
- * If `older_than_this' is non-zero then only flush inodes which have a
- * flushtime older than *older_than_this.
- *
- * If `bdi' is non-zero then we will scan the first inode against each
- * superblock until we find the matching ones.  One group will be the dirty
- * inodes against a filesystem.  Then when we hit the dummy blockdev superblock,
- * sync_sb_inodes will seekout the blockdev which matches `bdi'.  Maybe not
- * super-efficient but we're about to do a ton of I/O...
+ * Write back dirty pagecache data against @bdi as @args asks, in chunks of
+ * MAX_WRITEBACK_PAGES so that the limits get rechecked now and then.
+ * Data-integrity passes go through everything in one sweep.  Returns the
+ * number of pages written; args->nr_pages is reduced by as much.
  */
-void
-writeback_inodes(struct writeback_control *wbc)
+static long wb_writeback(struct backing_dev_info *bdi,
+			 struct wb_writeback_args *args)
 {
-	struct super_block *sb;
+	unsigned long oldest_jif;
+	long chunk = MAX_WRITEBACK_PAGES;
+	long wrote = 0;
+	struct writeback_control wbc = {
+		.bdi		= bdi,
+		.sync_mode	= args->sync_mode,
+		.older_than_this = NULL,
+		.nonblocking	= args->for_kupdate || args->for_background,
+		.for_kupdate	= args->for_kupdate,
+	};
 
-	might_sleep();
-	spin_lock(&sb_lock);
-restart:
-	sb = sb_entry(super_blocks.prev);
-	/*遍历super_blocks链表中所有的super_block*/
-	for (; sb != sb_entry(&super_blocks); sb = sb_entry(sb->s_list.prev)) {
-		/*如果脏的inode链表或待传输到磁盘的inode链表不为空则执行刷新*/
-		if (!list_empty(&sb->s_dirty) || !list_empty(&sb->s_io)) {
-			/* we're making our own get_super here */
-			sb->s_count++;
-			spin_unlock(&sb_lock);
-			/*
-			 * If we can't get the readlock, there's no sense in
-			 * waiting around, most of the time the FS is going to
-			 * be unmounted by the time it is released.
-			 */
-			if (down_read_trylock(&sb->s_umount)) {
-				if (sb->s_root) {
-					spin_lock(&inode_lock);
-					/*执行脏页写回操作*/
-					sync_sb_inodes(sb, wbc);
-					spin_unlock(&inode_lock);
-				}
-				up_read(&sb->s_umount);
-			}
-			spin_lock(&sb_lock);
-			if (__put_super_and_need_restart(sb))
-				goto restart;
-		}
-		if (wbc->nr_to_write <= 0)
+	if (wbc.for_kupdate) {
+		wbc.older_than_this = &oldest_jif;
+		oldest_jif = jiffies - (dirty_expire_centisecs * HZ) / 100;
+	}
+	if (args->sync_mode != WB_SYNC_NONE)
+		chunk = args->nr_pages;
+
+	while (args->nr_pages > 0) {
+		/*如果脏页数量低于阀值background_thresh，则终止*/
+		if (args->for_background && !over_bground_thresh())
 			break;
+
+		wbc.encountered_congestion = 0;
+		wbc.nr_to_write = chunk;
+		wbc.pages_skipped = 0;
+		spin_lock(&inode_lock);
+		writeback_bdi_inodes(bdi, &wbc, args->sb);
+		spin_unlock(&inode_lock);
+		args->nr_pages -= chunk - wbc.nr_to_write;
+		wrote += chunk - wbc.nr_to_write;
+
+		/*如果还有页面没有写或略过一些页面，可能块设备的请求队列处于拥塞状态*/
+		if (wbc.nr_to_write > 0 || wbc.pages_skipped > 0) {
+			/* Wrote less than expected */
+			if (!wbc.encountered_congestion)
+				break;	/* All there was is written */
+			blk_congestion_wait(WRITE, HZ/10);
+		}
 	}
-	spin_unlock(&sb_lock);
+	return wrote;
+}
+
+/*
+ * Periodic writeback of "old" data.
+ *
+ * Define "old": the first time one of an inode's pages is dirtied, we mark the
+ * dirtying-time in the inode's address_space.  So this periodic writeback code
+ * just walks the device's inode list, writing back any inodes which are
+ * older than a specific point in time.
+ *
+ * Runs once per dirty_writeback_centisecs.  older_than_this takes precedence
+ * over nr_to_write.  So we'll only write back all dirty pages if they are all
+ * attached to "old" mappings.
+ */
+static long wb_check_old_data_flush(struct backing_dev_info *bdi)
+{
+	unsigned long interval = (dirty_writeback_centisecs * HZ) / 100;
+	struct wb_writeback_args args = {
+		.sync_mode	= WB_SYNC_NONE,
+		.for_kupdate	= 1,
+	};
+
+	if (!interval || time_before(jiffies, bdi->wb_last_old_flush + interval))
+		return 0;
+	bdi->wb_last_old_flush = jiffies;
+
+	/*计算本次要写入的脏数据量*/
+	args.nr_pages = global_page_state(NR_FILE_DIRTY) +
+			global_page_state(NR_UNSTABLE_NFS) +
+			(inodes_stat.nr_inodes - inodes_stat.nr_unused);
+	return wb_writeback(bdi, &args);
+}
+
+/*
+ * Keep writing until the amount of dirty memory is less than the background
+ * threshold, or until this device is all clean.
+ */
+static long wb_check_background_flush(struct backing_dev_info *bdi)
+{
+	struct wb_writeback_args args = {
+		.nr_pages	= LONG_MAX,
+		.sync_mode	= WB_SYNC_NONE,
+		.for_background	= 1,
+	};
+
+	if (!bdi_has_dirty_io(bdi) || !over_bground_thresh())
+		return 0;
+	return wb_writeback(bdi, &args);
+}
+
+static struct bdi_work *bdi_next_work(struct backing_dev_info *bdi)
+{
+	struct bdi_work *work = NULL;
+
+	spin_lock(&bdi->wb_lock);
+	if (!list_empty(&bdi->work_list)) {
+		work = list_entry(bdi->work_list.next, struct bdi_work, list);
+		list_del_init(&work->list);
+	}
+	spin_unlock(&bdi->wb_lock);
+	return work;
+}
+
+/**
+ * wb_do_writeback - do everything that is pending for a device
+ * @bdi: the device
+ *
+ * Queued requests first, then kupdate-style writeback of old data if it is
+ * due, then background writeback if the machine is over the background
+ * threshold.  Runs in @bdi's flusher, or in whoever stands in for it.
+ * Returns the number of pages written.
+ */
+long wb_do_writeback(struct backing_dev_info *bdi)
+{
+	struct bdi_work *work;
+	int acquired;
+	long wrote = 0;
+
+	acquired = writeback_acquire(bdi);
+	while ((work = bdi_next_work(bdi)) != NULL) {
+		wrote += wb_writeback(bdi, &work->args);
+		if (work->done)
+			complete(work->done);
+		else
+			kfree(work);
+	}
+	wrote += wb_check_old_data_flush(bdi);
+	wrote += wb_check_background_flush(bdi);
+	if (acquired)
+		writeback_release(bdi);
+	return wrote;
+}
+
+/**
+ * bdi_writeback_thread - the flusher thread of one backing device
+ * @data: the device
+ *
+ * Started and stopped by mm/backing-dev.c.  Between requests it wakes every
+ * dirty_writeback_centisecs for kupdate-style writeback.
+ */
+int bdi_writeback_thread(void *data)
+{
+	struct backing_dev_info *bdi = data;
+
+	current->flags |= PF_FLUSHER;
+	/*
+	 * The flusher can spend a lot of time doing encryption via dm-crypt.
+	 * We don't want to do that at keventd's priority, nor outside the
+	 * cpuset of the thread that started us.
+	 */
+	set_user_nice(current, 0);
+	set_cpus_allowed(current, cpuset_cpus_allowed(current));
+
+	while (!kthread_should_stop()) {
+		if (wb_do_writeback(bdi))
+			bdi->wb_last_active = jiffies;
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (bdi_has_work(bdi) || kthread_should_stop()) {
+			__set_current_state(TASK_RUNNING);
+			continue;
+		}
+		if (dirty_writeback_centisecs)
+			schedule_timeout((dirty_writeback_centisecs * HZ) / 100);
+		else
+			schedule();
+		try_to_freeze();
+	}
+	return 0;
+}
+
+static void bdi_queue_work(struct backing_dev_info *bdi, struct bdi_work *work)
+{
+	spin_lock(&bdi->wb_lock);
+	list_add_tail(&work->list, &bdi->work_list);
+	if (bdi->wb_task)
+		wake_up_process(bdi->wb_task);
+	else
+		bdi_kick_forker();
+	spin_unlock(&bdi->wb_lock);
+}
+
+/**
+ * bdi_start_writeback - ask a device's flusher to write some pages
+ * @bdi: the device
+ * @nr_pages: how many
+ *
+ * Doesn't wait.  If the request cannot be allocated the flusher is merely
+ * woken, which still gets background writeback going if that is needed.
+ */
+void bdi_start_writeback(struct backing_dev_info *bdi, long nr_pages)
+{
+	struct bdi_work *work;
+
+	work = kmalloc(sizeof(*work), GFP_ATOMIC);
+	if (!work) {
+		bdi_wakeup_flusher(bdi);
+		return;
+	}
+	memset(work, 0, sizeof(*work));
+	work->args.nr_pages = nr_pages;
+	work->args.sync_mode = WB_SYNC_NONE;
+	bdi_queue_work(bdi, work);
+}
+EXPORT_SYMBOL(bdi_start_writeback);
+
+/**
+ * bdi_sync_writeback - have a device's flusher write some pages, and wait
+ * @bdi: the device
+ * @sb: only write this superblock's inodes, or NULL for all.  The caller
+ *	must hold @sb->s_umount.
+ * @nr_pages: how many
+ * @sync_mode: how to wait on each inode
+ *
+ * Throttled writers and sync come here, so that only the flusher submits
+ * writeback against the device.  Flushers themselves, and everybody before
+ * the flushers are up, do the writeback directly.  Returns the number of
+ * pages written.
+ *
+ * If the device has no flusher yet, it is started here rather than by the
+ * forker: sync_inodes_sb() waits with bdi_list_sem held, and the forker
+ * can be stuck behind it on that, waiting for its turn after a queued
+ * bdi_init() or bdi_destroy().
+ */
+long bdi_sync_writeback(struct backing_dev_info *bdi, struct super_block *sb,
+			long nr_pages, enum writeback_sync_modes sync_mode)
+{
+	DECLARE_COMPLETION(done);
+	struct bdi_work work = {
+		.args = {
+			.nr_pages	= nr_pages,
+			.sb		= sb,
+			.sync_mode	= sync_mode,
+		},
+		.done = &done,
+	};
+
+	if (current_is_flusher() || !bdi_forker_running()) {
+		wb_writeback(bdi, &work.args);
+	} else {
+		bdi_queue_work(bdi, &work);
+		if (!bdi->wb_task)
+			bdi_start_flusher(bdi);
+		wait_for_completion(&done);
+	}
+	return nr_pages - work.args.nr_pages;
+}
+EXPORT_SYMBOL(bdi_sync_writeback);
+
+/*
+ * Start writeback of `nr_pages' pages on every device with dirty inodes.
+ * If `nr_pages' is zero, write back the whole world.
+ */
+void wakeup_flusher_threads(long nr_pages)
+{
+	struct backing_dev_info *bdi;
+
+	if (nr_pages == 0)
+		nr_pages = global_page_state(NR_FILE_DIRTY) +
+				global_page_state(NR_UNSTABLE_NFS);
+
+	spin_lock(&bdi_lock);
+	list_for_each_entry(bdi, &bdi_list, bdi_list) {
+		if (!bdi_cap_writeback_dirty(bdi) || !bdi_has_dirty_io(bdi))
+			continue;
+		bdi_start_writeback(bdi, nr_pages);
+	}
+	spin_unlock(&bdi_lock);
 }
 
 /*
  * writeback and wait upon the filesystem's dirty inodes.  The caller will
  * do this in two passes - one to write, and one to wait.  WB_SYNC_HOLD is
- * used to park the written inodes on sb->s_dirty for the wait pass.
+ * used to park the written inodes on bdi->b_dirty for the wait pass.
+ *
+ * The filesystem's inodes may sit on several devices' lists, so each
+ * device with dirty inodes is asked in turn.  The caller holds
+ * sb->s_umount.
  *
  * A finite limit is set on the number of pages which will be written.
  * To prevent infinite livelock of sys_sync().
@@ -470,19 +746,24 @@ restart:
  */
 void sync_inodes_sb(struct super_block *sb, int wait)
 {
-	struct writeback_control wbc = {
-		.sync_mode	= wait ? WB_SYNC_ALL : WB_SYNC_HOLD,
-	};
-	unsigned long nr_dirty = read_page_state(nr_dirty);
-	unsigned long nr_unstable = read_page_state(nr_unstable);
+	struct backing_dev_info *bdi;
+	unsigned long nr_dirty = global_page_state(NR_FILE_DIRTY);
+	unsigned long nr_unstable = global_page_state(NR_UNSTABLE_NFS);
+	long nr_to_write;
 
-	wbc.nr_to_write = nr_dirty + nr_unstable +
+	nr_to_write = nr_dirty + nr_unstable +
 			(inodes_stat.nr_inodes - inodes_stat.nr_unused) +
 			nr_dirty + nr_unstable;
-	wbc.nr_to_write += wbc.nr_to_write / 2;		/* Bit more for luck */
-	spin_lock(&inode_lock);
-	sync_sb_inodes(sb, &wbc);
-	spin_unlock(&inode_lock);
+	nr_to_write += nr_to_write / 2;		/* Bit more for luck */
+
+	down_read(&bdi_list_sem);
+	list_for_each_entry(bdi, &bdi_list, bdi_list) {
+		if (!bdi_cap_writeback_dirty(bdi) || !bdi_has_dirty_io(bdi))
+			continue;
+		bdi_sync_writeback(bdi, sb, nr_to_write,
+				   wait ? WB_SYNC_ALL : WB_SYNC_HOLD);
+	}
+	up_read(&bdi_list_sem);
 }
 
 /*
@@ -668,17 +949,16 @@ EXPORT_SYMBOL(generic_osync_inode);
  * writeback_acquire: attempt to get exclusive writeback access to a device
  * @bdi: the device's backing_dev_info structure
  *
- * It is a waste of resources to have more than one pdflush thread blocked on
- * a single request queue.  Exclusion at the request_queue level is obtained
- * via a flag in the request_queue's backing_dev_info.state.
+ * Taken by the device's flusher while it works, so that throttled writers
+ * can see that background writeback is already under way.
  *
  * Non-request_queue-backed address_spaces will share default_backing_dev_info,
- * unless they implement their own.  Which is somewhat inefficient, as this
- * may prevent concurrent writeback against multiple devices.
+ * unless they implement their own.  Which is somewhat inefficient, as they
+ * then share one flusher.
  */
 int writeback_acquire(struct backing_dev_info *bdi)
 {
-	return !test_and_set_bit(BDI_pdflush, &bdi->state);
+	return !test_and_set_bit(BDI_writeback_running, &bdi->state);
 }
 
 /**
@@ -688,7 +968,7 @@ int writeback_acquire(struct backing_dev_info *bdi)
  */
 int writeback_in_progress(struct backing_dev_info *bdi)
 {
-	return test_bit(BDI_pdflush, &bdi->state);
+	return test_bit(BDI_writeback_running, &bdi->state);
 }
 
 /**
@@ -698,5 +978,5 @@ int writeback_in_progress(struct backing_dev_info *bdi)
 void writeback_release(struct backing_dev_info *bdi)
 {
 	BUG_ON(!writeback_in_progress(bdi));
-	clear_bit(BDI_pdflush, &bdi->state);
+	clear_bit(BDI_writeback_running, &bdi->state);
 }
@@ -7,6 +7,7 @@
  */
 
 #include <linux/buffer_head.h>		/* for fsync_inode_buffers() */
+#include <linux/splice.h>
 #include "minix.h"
 
 /*
@@ -19,9 +20,13 @@ struct file_operations minix_file_operations = {
 	.llseek		= generic_file_llseek,
 	.read		= generic_file_read,
 	.write		= generic_file_write,
+	.aio_readv	= generic_file_aio_readv,
+	.aio_writev	= generic_file_aio_writev,
 	.mmap		= generic_file_mmap,
 	.fsync		= minix_sync_file,
 	.sendfile	= generic_file_sendfile,
+	.splice_read	= generic_file_splice_read,
+	.splice_write	= generic_file_splice_write,
 };
 
 struct inode_operations minix_file_inode_operations = {
@@ -12,6 +12,7 @@
 #include <linux/module.h>
 #include "minix.h"
 #include <linux/buffer_head.h>
+#include <linux/mpage.h>
 #include <linux/slab.h>
 #include <linux/init.h>
 #include <linux/highuid.h>
@@ -326,20 +327,39 @@ static int minix_readpage(struct file *file, struct page *page)
 {
 	return block_read_full_page(page,minix_get_block);
 }
+static int minix_readpages(struct file *file, struct address_space *mapping,
+		struct list_head *pages, unsigned nr_pages)
+{
+	return mpage_readpages(mapping, pages, nr_pages, minix_get_block);
+}
+static int minix_writepages(struct address_space *mapping,
+		struct writeback_control *wbc)
+{
+	return mpage_writepages(mapping, wbc, minix_get_block);
+}
 static int minix_prepare_write(struct file *file, struct page *page, unsigned from, unsigned to)
 {
 	return block_prepare_write(page,from,to,minix_get_block);
 }
+static int minix_prepare_write_pages(struct file *file, struct page **pages,
+		unsigned nr, unsigned from, unsigned to)
+{
+	return block_prepare_write_pages(pages, nr, from, to, minix_get_block);
+}
 static sector_t minix_bmap(struct address_space *mapping, sector_t block)
 {
 	return generic_block_bmap(mapping,block,minix_get_block);
 }
 static struct address_space_operations minix_aops = {
 	.readpage = minix_readpage,
+	.readpages = minix_readpages,
 	.writepage = minix_writepage,
+	.writepages = minix_writepages,
 	.sync_page = block_sync_page,
 	.prepare_write = minix_prepare_write,
 	.commit_write = generic_commit_write,
+	.prepare_write_pages = minix_prepare_write_pages,
+	.commit_write_pages = generic_commit_write_pages,
 	.bmap = minix_bmap
 };
 
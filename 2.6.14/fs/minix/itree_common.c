@@ -105,6 +105,23 @@ static int alloc_branch(struct inode *inode,
 	return -ENOSPC;
 }
 
+/*
+ * How many blocks, up to @max, starting with the one at @p are contiguous
+ * on disk.  Only the pointers that share @p's array (i_data or one
+ * indirect block) are looked at, so this costs no further reads.
+ */
+static inline int count_run(block_t *p, block_t *end, int max)
+{
+	unsigned long first = block_to_cpu(*p);
+	int n = 1;
+
+	read_lock(&pointers_lock);
+	while (n < max && p + n < end && block_to_cpu(p[n]) == first + n)
+		n++;
+	read_unlock(&pointers_lock);
+	return n;
+}
+
 static inline int splice_branch(struct inode *inode,
 				     Indirect chain[DEPTH],
 				     Indirect *where,
@@ -150,6 +167,7 @@ static inline int get_block(struct inode * inode, sector_t block,
 	Indirect chain[DEPTH];
 	Indirect *partial;
 	int left;
+	int count = 1;
 	int depth = block_to_path(inode, block, offsets);
 
 	if (depth == 0)
@@ -160,8 +178,14 @@ reread:
 
 	/* Simplest case - block found, no allocation needed */
 	if (!partial) {
+		/* The caller may take the rest of a contiguous run too */
+		count = count_run(chain[depth-1].p, chain[depth-1].bh ?
+				  block_end(chain[depth-1].bh) :
+				  i_data(inode) + DIRECT,
+				  bh->b_size >> inode->i_blkbits);
 got_it:
 		map_bh(bh, inode->i_sb, block_to_cpu(chain[depth-1].key));
+		bh->b_size = count << inode->i_blkbits;
 		/* Clean up and exit */
 		partial = chain+depth-1; /* the whole chain */
 		goto cleanup;
@@ -171,10 +171,17 @@ map_buffer_to_page(struct page *page, struct buffer_head *bh, int page_block)
 /*
  * 执行从磁盘读取page
  * @nr_pages: 对于mpage_readpage，nr_pages为1
+ *
+ * get_block is asked to map everything from the page up to the end of the
+ * readahead window, and may map several blocks at once by returning a
+ * b_size larger than the block size.  Such a mapping is kept in @map_bh,
+ * starting at file block *@first_logical_block, so that the next pages
+ * are served from it without calling get_block again.
  */
 static struct bio *
 do_mpage_readpage(struct bio *bio, struct page *page, unsigned nr_pages,
-			sector_t *last_block_in_bio, get_block_t get_block)
+			sector_t *last_block_in_bio, struct buffer_head *map_bh,
+			sector_t *first_logical_block, get_block_t get_block)
 {
 	struct inode *inode = page->mapping->host;
 	const unsigned blkbits = inode->i_blkbits;
@@ -182,14 +189,16 @@ do_mpage_readpage(struct bio *bio, struct page *page, unsigned nr_pages,
 	const unsigned blocksize = 1 << blkbits;
 	sector_t block_in_file;
 	sector_t last_block;
+	sector_t last_block_in_file;
 	/*用于存放page中每个buffer对应的磁盘逻辑块号*/
 	sector_t blocks[MAX_BUF_PER_PAGE];
 	unsigned page_block;
 	/*如果first_hole ！= blocks_per_page表示文件块有空洞*/
 	unsigned first_hole = blocks_per_page;
 	struct block_device *bdev = NULL;
-	struct buffer_head bh;
 	int length;
+	unsigned nblocks;
+	unsigned relative_block;
 	/*表示文件块是否有空洞，为1表示整个文件都可以映射到磁盘逻辑块号，无空洞*/
 	int fully_mapped = 1;
 
@@ -205,27 +214,63 @@ do_mpage_readpage(struct bio *bio, struct page *page, unsigned nr_pages,
 	 * 获取索引为index的page的首个块的文件块号
 	 * Note:文件块大小来自inode->i_blkbits，一般为4k or 512?
 	 */
-	block_in_file = page->index << (PAGE_CACHE_SHIFT - blkbits);
+	block_in_file = (sector_t)page->index << (PAGE_CACHE_SHIFT - blkbits);
+	/* The readahead window ends here, or at EOF if that comes first */
+	last_block = block_in_file + nr_pages * blocks_per_page;
 	/*获取文件最后一个块对应的文件块号*/
-	last_block = (i_size_read(inode) + blocksize - 1) >> blkbits;
+	last_block_in_file = (i_size_read(inode) + blocksize - 1) >> blkbits;
+	if (last_block > last_block_in_file)
+		last_block = last_block_in_file;
+	page_block = 0;
 
-	bh.b_page = page;
+	/*
+	 * Map what we can with the mapping left over from the previous page.
+	 */
+	nblocks = map_bh->b_size >> blkbits;
+	if (buffer_mapped(map_bh) && block_in_file > *first_logical_block &&
+	    block_in_file < *first_logical_block + nblocks) {
+		unsigned map_offset = block_in_file - *first_logical_block;
+		unsigned last = nblocks - map_offset;
+
+		for (relative_block = 0; ; relative_block++) {
+			if (relative_block == last) {
+				clear_buffer_mapped(map_bh);
+				break;
+			}
+			if (page_block == blocks_per_page)
+				break;
+			blocks[page_block] = map_bh->b_blocknr + map_offset +
+						relative_block;
+			page_block++;
+			block_in_file++;
+		}
+		bdev = map_bh->b_bdev;
+	}
+
+	/*
+	 * Then call get_block for the rest of the page.
+	 */
+	map_bh->b_page = page;
 	/*遍历page的所有的文件块，获取对应的磁盘逻辑块号，保存在本地blocks数组*/
-	for (page_block = 0; page_block < blocks_per_page;
-				page_block++, block_in_file++) {
-		bh.b_state = 0;
+	while (page_block < blocks_per_page) {
+		map_bh->b_state = 0;
+		map_bh->b_size = 0;
 		if (block_in_file < last_block) {
+			map_bh->b_size = (last_block - block_in_file) << blkbits;
 			/*通过get_block获取文件块号在磁盘或分区对应的的逻辑块号，保存在bh中*/
-			if (get_block(inode, block_in_file, &bh, 0))
+			if (get_block(inode, block_in_file, map_bh, 0))
 				goto confused;
+			*first_logical_block = block_in_file;
 		}
 		/*如果page当前的文件块号没有磁盘逻辑块对应,则说明page当前文件块号为空洞*/
-		if (!buffer_mapped(&bh)) {
+		if (!buffer_mapped(map_bh)) {
 			/*表示page当前文件块空洞，不能完全映射*/
 			fully_mapped = 0;
 			if (first_hole == blocks_per_page)
 				/*标示空洞的文件块号*/
 				first_hole = page_block;
+			page_block++;
+			block_in_file++;
 			continue;
 		}
 
@@ -236,9 +281,9 @@ do_mpage_readpage(struct bio *bio, struct page *page, unsigned nr_pages,
 		 * so readpage doesn't have to repeat the get_block call
 		 */
 		/*如果get_block已经将逻辑块数据读取到buffer，则page的buffer已经是最新*/
-		if (buffer_uptodate(&bh)) {
+		if (buffer_uptodate(map_bh)) {
 			/*以bh初始化page的第page_block个buffer对应的bh*/
-			map_buffer_to_page(page, &bh, page_block);
+			map_buffer_to_page(page, map_bh, page_block);
 			goto confused;
 		}
 		/*如果page的文件块有空洞,要采用一次读一块的方式读该页*/	
@@ -247,10 +292,24 @@ do_mpage_readpage(struct bio *bio, struct page *page, unsigned nr_pages,
 
 		/* Contiguous blocks? */
 		/*如果page的两个相邻的文件块号对应的磁盘逻辑块号不相邻，要采用一次读一块的方式读该页*/
-		if (page_block && blocks[page_block-1] != bh.b_blocknr-1)
+		if (page_block && blocks[page_block-1] != map_bh->b_blocknr-1)
+			goto confused;
+		nblocks = map_bh->b_size >> blkbits;
+		if (!nblocks)
 			goto confused;
-		blocks[page_block] = bh.b_blocknr;
-		bdev = bh.b_bdev;
+		for (relative_block = 0; ; relative_block++) {
+			if (relative_block == nblocks) {
+				/* Used up: the next page must call get_block */
+				clear_buffer_mapped(map_bh);
+				break;
+			}
+			if (page_block == blocks_per_page)
+				break;
+			blocks[page_block] = map_bh->b_blocknr + relative_block;
+			page_block++;
+			block_in_file++;
+		}
+		bdev = map_bh->b_bdev;
 	}
 	/*对于page的文件块有空洞的，需要将对应的页的buffer清零*/
 	if (first_hole != blocks_per_page) {
@@ -293,7 +352,7 @@ alloc_new:
 		goto alloc_new;
 	}
 
-	if (buffer_boundary(&bh) || (first_hole != blocks_per_page))
+	if (buffer_boundary(map_bh) || (first_hole != blocks_per_page))
 		bio = mpage_bio_submit(READ, bio);
 	else
 		*last_block_in_bio = blocks[blocks_per_page - 1];
@@ -366,7 +425,11 @@ mpage_readpages(struct address_space *mapping, struct list_head *pages,
 	unsigned page_idx;
 	sector_t last_block_in_bio = 0;
 	struct pagevec lru_pvec;
+	struct buffer_head map_bh;
+	sector_t first_logical_block = 0;
 
+	map_bh.b_state = 0;
+	map_bh.b_size = 0;
 	pagevec_init(&lru_pvec, 0);
 	for (page_idx = 0; page_idx < nr_pages; page_idx++) {
 		struct page *page = list_entry(pages->prev, struct page, lru);
@@ -377,7 +440,8 @@ mpage_readpages(struct address_space *mapping, struct list_head *pages,
 					page->index, GFP_KERNEL)) {
 			bio = do_mpage_readpage(bio, page,
 					nr_pages - page_idx,
-					&last_block_in_bio, get_block);
+					&last_block_in_bio, &map_bh,
+					&first_logical_block, get_block);
 			if (!pagevec_add(&lru_pvec, page))
 				__pagevec_lru_add(&lru_pvec);
 		} else {
@@ -406,9 +470,13 @@ int mpage_readpage(struct page *page, get_block_t get_block)
 {
 	struct bio *bio = NULL;
 	sector_t last_block_in_bio = 0;
+	struct buffer_head map_bh;
+	sector_t first_logical_block = 0;
 
-	bio = do_mpage_readpage(bio, page, 1,
-			&last_block_in_bio, get_block);
+	map_bh.b_state = 0;
+	map_bh.b_size = 0;
+	bio = do_mpage_readpage(bio, page, 1, &last_block_in_bio,
+			&map_bh, &first_logical_block, get_block);
 	if (bio)
 		mpage_bio_submit(READ, bio);
 	return 0;
@@ -519,15 +587,26 @@ __mpage_writepage(struct bio *bio, struct page *page, get_block_t get_block,
 	last_block = (i_size - 1) >> blkbits;
 	map_bh.b_page = page;
 	for (page_block = 0; page_block < blocks_per_page; ) {
+		unsigned want, nblocks, i;
 
+		/* Ask for the rest of the page: it may come in one mapping */
+		want = blocks_per_page - page_block;
+		if (want > last_block - block_in_file + 1)
+			want = last_block - block_in_file + 1;
 		map_bh.b_state = 0;
+		map_bh.b_size = want << blkbits;
 		if (get_block(inode, block_in_file, &map_bh, 1))
 			goto confused;
-		if (buffer_new(&map_bh))
-			unmap_underlying_metadata(map_bh.b_bdev,
-						map_bh.b_blocknr);
+		nblocks = map_bh.b_size >> blkbits;
+		if (!nblocks || nblocks > want)
+			goto confused;
+		if (buffer_new(&map_bh)) {
+			for (i = 0; i < nblocks; i++)
+				unmap_underlying_metadata(map_bh.b_bdev,
+						map_bh.b_blocknr + i);
+		}
 		if (buffer_boundary(&map_bh)) {
-			boundary_block = map_bh.b_blocknr;
+			boundary_block = map_bh.b_blocknr + nblocks - 1;
 			boundary_bdev = map_bh.b_bdev;
 		}
 		if (page_block) {
@@ -535,12 +614,13 @@ __mpage_writepage(struct bio *bio, struct page *page, get_block_t get_block,
 			if (map_bh.b_blocknr != blocks[page_block-1] + 1)
 				goto confused;
 		}
-		blocks[page_block++] = map_bh.b_blocknr;
+		for (i = 0; i < nblocks; i++)
+			blocks[page_block++] = map_bh.b_blocknr + i;
 		boundary = buffer_boundary(&map_bh);
 		bdev = map_bh.b_bdev;
-		if (block_in_file == last_block)
+		block_in_file += nblocks;
+		if (block_in_file > last_block)
 			break;
-		block_in_file++;
 	}
 	BUG_ON(page_block == 0);
 
@@ -14,6 +14,8 @@
 #include <linux/security.h>
 #include <linux/module.h>
 #include <linux/syscalls.h>
+#include <linux/splice.h>
+#include <linux/compat.h>
 
 #include <asm/uaccess.h>
 #include <asm/unistd.h>
@@ -23,6 +25,7 @@ struct file_operations generic_ro_fops = {
 	.read		= generic_file_read,
 	.mmap		= generic_file_readonly_mmap,
 	.sendfile	= generic_file_sendfile,
+	.splice_read	= generic_file_splice_read,
 };
 
 EXPORT_SYMBOL(generic_ro_fops);
@@ -630,6 +633,148 @@ sys_writev(unsigned long fd, const struct iovec __user *vec, unsigned long vlen)
 	return ret;
 }
 
+/*
+ * The offset of preadv/pwritev is passed as two longs so that 32-bit
+ * architectures don't need register-pair alignment tricks; the double
+ * shift avoids an undefined shift by BITS_PER_LONG on 64-bit.
+ */
+#define HALF_LONG_BITS (BITS_PER_LONG / 2)
+
+static inline loff_t pos_from_hilo(unsigned long high, unsigned long low)
+{
+	return (((loff_t)high << HALF_LONG_BITS) << HALF_LONG_BITS) | low;
+}
+
+static ssize_t do_preadv(unsigned long fd, const struct iovec __user *vec,
+			 unsigned long vlen, loff_t pos)
+{
+	struct file *file;
+	ssize_t ret = -EBADF;
+	int fput_needed;
+
+	if (pos < 0)
+		return -EINVAL;
+
+	file = fget_light(fd, &fput_needed);
+	if (file) {
+		ret = -ESPIPE;
+		if (file->f_mode & FMODE_PREAD)
+			ret = vfs_readv(file, vec, vlen, &pos);
+		fput_light(file, fput_needed);
+	}
+
+	if (ret > 0)
+		current->rchar += ret;
+	current->syscr++;
+	return ret;
+}
+
+static ssize_t do_pwritev(unsigned long fd, const struct iovec __user *vec,
+			  unsigned long vlen, loff_t pos)
+{
+	struct file *file;
+	ssize_t ret = -EBADF;
+	int fput_needed;
+
+	if (pos < 0)
+		return -EINVAL;
+
+	file = fget_light(fd, &fput_needed);
+	if (file) {
+		ret = -ESPIPE;
+		if (file->f_mode & FMODE_PWRITE)
+			ret = vfs_writev(file, vec, vlen, &pos);
+		fput_light(file, fput_needed);
+	}
+
+	if (ret > 0)
+		current->wchar += ret;
+	current->syscw++;
+	return ret;
+}
+
+/*
+ * readv/writev at an explicit offset: f_pos is neither used nor updated,
+ * so threads sharing a descriptor need no lseek and no lock around it.
+ */
+asmlinkage ssize_t
+sys_preadv(unsigned long fd, const struct iovec __user *vec,
+	   unsigned long vlen, unsigned long pos_l, unsigned long pos_h)
+{
+	return do_preadv(fd, vec, vlen, pos_from_hilo(pos_h, pos_l));
+}
+
+asmlinkage ssize_t
+sys_pwritev(unsigned long fd, const struct iovec __user *vec,
+	    unsigned long vlen, unsigned long pos_l, unsigned long pos_h)
+{
+	return do_pwritev(fd, vec, vlen, pos_from_hilo(pos_h, pos_l));
+}
+
+#ifdef CONFIG_COMPAT
+/*
+ * Widen a 32-bit iovec array into a native one in the compat user space
+ * scratch area, so the native vfs_readv/vfs_writev checks apply unchanged.
+ */
+static int compat_convert_iovec(const struct compat_iovec __user *uvec,
+				unsigned long vlen, struct iovec __user **iovp)
+{
+	struct iovec __user *iov;
+	unsigned long i;
+
+	if (vlen > UIO_MAXIOV)
+		return -EINVAL;
+	if (!access_ok(VERIFY_READ, uvec, vlen * sizeof(*uvec)))
+		return -EFAULT;
+
+	iov = compat_alloc_user_space(vlen * sizeof(*iov));
+	for (i = 0; i < vlen; i++) {
+		compat_uptr_t base;
+		compat_ssize_t len;
+
+		if (__get_user(base, &uvec[i].iov_base) ||
+		    __get_user(len, &uvec[i].iov_len))
+			return -EFAULT;
+		/* must not turn into a valid length on 64-bit */
+		if (len < 0)
+			return -EINVAL;
+		if (put_user(compat_ptr(base), &iov[i].iov_base) ||
+		    put_user((size_t)len, &iov[i].iov_len))
+			return -EFAULT;
+	}
+	*iovp = iov;
+	return 0;
+}
+
+asmlinkage ssize_t
+compat_sys_preadv(unsigned long fd, const struct compat_iovec __user *vec,
+		  unsigned long vlen, u32 pos_low, u32 pos_high)
+{
+	loff_t pos = ((loff_t)pos_high << 32) | pos_low;
+	struct iovec __user *iov;
+	int ret;
+
+	ret = compat_convert_iovec(vec, vlen, &iov);
+	if (ret)
+		return ret;
+	return do_preadv(fd, iov, vlen, pos);
+}
+
+asmlinkage ssize_t
+compat_sys_pwritev(unsigned long fd, const struct compat_iovec __user *vec,
+		   unsigned long vlen, u32 pos_low, u32 pos_high)
+{
+	loff_t pos = ((loff_t)pos_high << 32) | pos_low;
+	struct iovec __user *iov;
+	int ret;
+
+	ret = compat_convert_iovec(vec, vlen, &iov);
+	if (ret)
+		return ret;
+	return do_pwritev(fd, iov, vlen, pos);
+}
+#endif
+
 static ssize_t do_sendfile(int out_fd, int in_fd, loff_t *ppos,
 			   size_t count, loff_t max)
 {
@@ -758,3 +903,118 @@ asmlinkage ssize_t sys_sendfile64(int out_fd, int in_fd, loff_t __user *offset,
 
 	return do_sendfile(out_fd, in_fd, NULL, count, 0);
 }
+
+static int copy_file_range_ok(struct file *file)
+{
+	struct inode *inode = file->f_mapping->host;
+
+	return S_ISREG(inode->i_mode) || S_ISBLK(inode->i_mode);
+}
+
+/*
+ * sys_copy_file_range:
+ *	Copy up to len bytes from fd_in to fd_out inside the kernel, with
+ *	do_splice_direct().  The source's ->splice_read() takes references
+ *	to its page cache pages (with readahead), and the destination's
+ *	->splice_write() copies them into its own page cache, so the data
+ *	never takes a trip through a user space buffer and dirty page
+ *	throttling applies as for write().  off_in/off_out, if given, are
+ *	used instead of the file positions and are updated.  Returns the
+ *	number of bytes copied.
+ */
+asmlinkage ssize_t sys_copy_file_range(int fd_in, loff_t __user *off_in,
+				       int fd_out, loff_t __user *off_out,
+				       size_t len, unsigned int flags)
+{
+	struct file *in, *out;
+	struct inode *in_inode, *out_inode;
+	loff_t pos_in, pos_out, *ppos_in;
+	int fput_needed_in, fput_needed_out;
+	ssize_t ret;
+
+	if (flags)
+		return -EINVAL;
+
+	ret = -EBADF;
+	in = fget_light(fd_in, &fput_needed_in);
+	if (!in)
+		goto out;
+	if (!(in->f_mode & FMODE_READ))
+		goto fput_in;
+	out = fget_light(fd_out, &fput_needed_out);
+	if (!out)
+		goto fput_in;
+	if (!(out->f_mode & FMODE_WRITE))
+		goto fput_out;
+
+	ret = -EINVAL;
+	in_inode = in->f_mapping->host;
+	out_inode = out->f_mapping->host;
+	if (!copy_file_range_ok(in) || !copy_file_range_ok(out))
+		goto fput_out;
+	if (!in->f_op || !in->f_op->splice_read ||
+	    !out->f_op || !out->f_op->splice_write)
+		goto fput_out;
+
+	ppos_in = &in->f_pos;
+	pos_out = out->f_pos;
+	ret = -EFAULT;
+	if (off_in) {
+		if (copy_from_user(&pos_in, off_in, sizeof(loff_t)))
+			goto fput_out;
+		ppos_in = &pos_in;
+	}
+	if (off_out && copy_from_user(&pos_out, off_out, sizeof(loff_t)))
+		goto fput_out;
+
+	/* a copy that overlaps itself would read back its own output */
+	ret = -EINVAL;
+	if (in_inode == out_inode &&
+	    *ppos_in < pos_out + len && pos_out < *ppos_in + len)
+		goto fput_out;
+
+	ret = rw_verify_area(READ, in, ppos_in, len);
+	if (ret)
+		goto fput_out;
+	ret = security_file_permission(in, MAY_READ);
+	if (ret)
+		goto fput_out;
+	ret = rw_verify_area(WRITE, out, &pos_out, len);
+	if (ret)
+		goto fput_out;
+	ret = security_file_permission(out, MAY_WRITE);
+	if (ret)
+		goto fput_out;
+
+	ret = 0;
+	if (!len)
+		goto fput_out;
+
+	/* ->splice_write() does the suid removal and O_SYNC writeout */
+	ret = do_splice_direct(in, ppos_in, out, &pos_out, len, 0);
+	if (ret > 0) {
+		current->rchar += ret;
+		current->wchar += ret;
+		fsnotify_access(in->f_dentry);
+		fsnotify_modify(out->f_dentry);
+	}
+	current->syscr++;
+	current->syscw++;
+
+	if (off_in) {
+		if (copy_to_user(off_in, &pos_in, sizeof(loff_t)))
+			ret = -EFAULT;
+	}
+	if (off_out) {
+		if (copy_to_user(off_out, &pos_out, sizeof(loff_t)))
+			ret = -EFAULT;
+	} else
+		out->f_pos = pos_out;
+
+fput_out:
+	fput_light(out, fput_needed_out);
+fput_in:
+	fput_light(in, fput_needed_in);
+out:
+	return ret;
+}
@@ -0,0 +1,264 @@
+/*
+ *  linux/fs/splice.c
+ *
+ * Zero-copy data movement between files.
+ *
+ * ->splice_read() fills a splice_pipe with references to the source's
+ * page cache pages instead of copying them, ->splice_write() drains those
+ * references into the destination: sockets take the pages as they are
+ * through ->sendpage(), files get them copied once, kernel to kernel, into
+ * their own page cache.  Nothing passes through user space.
+ */
+
+#include <linux/config.h>
+#include <linux/fs.h>
+#include <linux/pagemap.h>
+#include <linux/splice.h>
+#include <linux/buffer_head.h>
+#include <linux/writeback.h>
+#include <linux/module.h>
+
+static inline struct splice_buffer *splice_pipe_head(struct splice_pipe *pipe)
+{
+	return &pipe->bufs[pipe->curbuf];
+}
+
+static void splice_pipe_consume(struct splice_pipe *pipe)
+{
+	struct splice_buffer *buf = splice_pipe_head(pipe);
+
+	page_cache_release(buf->page);
+	buf->page = NULL;
+	pipe->curbuf = (pipe->curbuf + 1) % SPLICE_BUFFERS;
+	pipe->nrbufs--;
+}
+
+/*
+ * Drop the page references of all buffers that were not consumed.
+ */
+void splice_pipe_release(struct splice_pipe *pipe)
+{
+	while (pipe->nrbufs)
+		splice_pipe_consume(pipe);
+	pipe->curbuf = 0;
+}
+EXPORT_SYMBOL(splice_pipe_release);
+
+/*
+ * Read actor that takes a reference on the page cache page instead of
+ * copying it.  Returning short stops do_generic_mapping_read() once the
+ * pipe is full.
+ */
+static int splice_read_actor(read_descriptor_t *desc, struct page *page,
+			     unsigned long offset, unsigned long size)
+{
+	struct splice_pipe *pipe = desc->arg.data;
+	struct splice_buffer *buf;
+	unsigned long count = desc->count;
+
+	if (pipe->nrbufs == SPLICE_BUFFERS)
+		return 0;
+	if (size > count)
+		size = count;
+
+	buf = &pipe->bufs[(pipe->curbuf + pipe->nrbufs) % SPLICE_BUFFERS];
+	page_cache_get(page);
+	buf->page = page;
+	buf->offset = offset;
+	buf->len = size;
+	pipe->nrbufs++;
+
+	desc->count = count - size;
+	desc->written += size;
+	return size;
+}
+
+/**
+ * generic_file_splice_read - splice page cache pages into a splice_pipe
+ * @in:		file to read from
+ * @ppos:	position in @in, advanced by the amount spliced
+ * @pipe:	pipe to fill
+ * @len:	maximum number of bytes to splice
+ * @flags:	SPLICE_F_* flags
+ *
+ * Goes through the normal read path (readahead, ->readpage), but the pipe
+ * ends up holding references to the page cache pages themselves.
+ */
+ssize_t generic_file_splice_read(struct file *in, loff_t *ppos,
+				 struct splice_pipe *pipe, size_t len,
+				 unsigned int flags)
+{
+	read_descriptor_t desc;
+
+	if (!len || pipe->nrbufs == SPLICE_BUFFERS)
+		return 0;
+
+	desc.written = 0;
+	desc.count = len;
+	desc.arg.data = pipe;
+	desc.error = 0;
+
+	do_generic_file_read(in, ppos, &desc, splice_read_actor);
+	if (desc.written)
+		return desc.written;
+	return desc.error;
+}
+EXPORT_SYMBOL(generic_file_splice_read);
+
+/**
+ * generic_file_splice_write - splice the contents of a pipe into a file
+ * @pipe:	pipe to drain
+ * @out:	file to write to
+ * @ppos:	position in @out, advanced by the amount written
+ * @len:	maximum number of bytes to write
+ * @flags:	SPLICE_F_* flags
+ *
+ * The data is copied from the pipe's pages straight into @out's page
+ * cache with generic_file_write_page().
+ */
+ssize_t generic_file_splice_write(struct splice_pipe *pipe, struct file *out,
+				  loff_t *ppos, size_t len, unsigned int flags)
+{
+	struct address_space *mapping = out->f_mapping;
+	struct inode *inode = mapping->host;
+	loff_t pos = *ppos;
+	ssize_t written = 0;
+	ssize_t ret;
+
+	down(&inode->i_sem);
+	ret = generic_write_checks(out, &pos, &len, S_ISBLK(inode->i_mode));
+	if (ret || !len)
+		goto out;
+	ret = remove_suid(out->f_dentry);
+	if (ret)
+		goto out;
+	inode_update_time(inode, 1);
+
+	while (len && pipe->nrbufs) {
+		struct splice_buffer *buf = splice_pipe_head(pipe);
+		size_t this_len = min_t(size_t, buf->len, len);
+
+		ret = generic_file_write_page(out, buf->page, buf->offset,
+					      this_len, &pos);
+		if (ret <= 0)
+			break;
+
+		written += ret;
+		len -= ret;
+		buf->offset += ret;
+		buf->len -= ret;
+		if (!buf->len)
+			splice_pipe_consume(pipe);
+		if (ret < this_len)
+			break;
+	}
+	*ppos = pos;
+out:
+	up(&inode->i_sem);
+
+	if (written > 0 && ((out->f_flags & O_SYNC) || IS_SYNC(inode))) {
+		int err;
+
+		err = sync_page_range(inode, mapping, pos - written, written);
+		if (err < 0)
+			written = err;
+	}
+	return written ? written : ret;
+}
+EXPORT_SYMBOL(generic_file_splice_write);
+
+/**
+ * generic_splice_sendpage - splice the contents of a pipe into a socket
+ * @pipe:	pipe to drain
+ * @out:	socket to write to
+ * @ppos:	position in @out
+ * @len:	maximum number of bytes to send
+ * @flags:	SPLICE_F_* flags
+ *
+ * Hands the pipe's pages to ->sendpage() as they are, for the
+ * file_operations of anything that implements ->sendpage().
+ */
+ssize_t generic_splice_sendpage(struct splice_pipe *pipe, struct file *out,
+				loff_t *ppos, size_t len, unsigned int flags)
+{
+	ssize_t written = 0;
+	ssize_t ret = 0;
+
+	while (len && pipe->nrbufs) {
+		struct splice_buffer *buf = splice_pipe_head(pipe);
+		size_t this_len = min_t(size_t, buf->len, len);
+		int more;
+
+		more = (flags & SPLICE_F_MORE) || this_len < len ||
+			pipe->nrbufs > 1;
+		ret = out->f_op->sendpage(out, buf->page, buf->offset,
+					  this_len, ppos, more);
+		if (ret <= 0)
+			break;
+
+		written += ret;
+		len -= ret;
+		buf->offset += ret;
+		buf->len -= ret;
+		if (!buf->len)
+			splice_pipe_consume(pipe);
+		if (ret < this_len)
+			break;
+	}
+	return written ? written : ret;
+}
+EXPORT_SYMBOL(generic_splice_sendpage);
+
+/**
+ * do_splice_direct - move data between two files in the kernel
+ * @in: the source, which must have ->splice_read
+ * @ppos_in: where to read from; advanced by what @out took
+ * @out: the destination, which must have ->splice_write
+ * @ppos_out: where to write to
+ * @len: how much to move
+ * @flags: SPLICE_F_* flags
+ *
+ * Moves the data through an on-stack splice_pipe, one pipeful at a time.
+ * The caller does the permission and rw_verify_area() checks.  Returns
+ * the number of bytes moved, or a negative error if nothing was.
+ *
+ * This is how sys_copy_file_range() moves its data.  There is no splice
+ * system call: real pipes cannot hold splice buffers in this tree.
+ */
+long do_splice_direct(struct file *in, loff_t *ppos_in,
+		      struct file *out, loff_t *ppos_out,
+		      size_t len, unsigned int flags)
+{
+	struct splice_pipe pipe;
+	long total = 0;
+	ssize_t ret = 0;
+
+	splice_pipe_init(&pipe);
+	while (len) {
+		ssize_t read;
+
+		ret = in->f_op->splice_read(in, ppos_in, &pipe, len, flags);
+		if (ret <= 0)
+			break;
+		read = ret;
+
+		ret = out->f_op->splice_write(&pipe, out, ppos_out, read,
+				read < len ? flags | SPLICE_F_MORE : flags);
+		/* whatever the destination didn't take goes back to the source */
+		splice_pipe_release(&pipe);
+		if (ret <= 0) {
+			*ppos_in -= read;
+			break;
+		}
+
+		total += ret;
+		len -= ret;
+		if (ret < read) {
+			*ppos_in -= read - ret;
+			break;
+		}
+		cond_resched();
+	}
+	return total ? total : ret;
+}
+EXPORT_SYMBOL(do_splice_direct);
@@ -36,6 +36,7 @@
 #include <linux/vfs.h>
 #include <linux/writeback.h>		/* for the emergency remount stuff */
 #include <linux/idr.h>
+#include <linux/workqueue.h>
 #include <linux/kobject.h>
 #include <asm/uaccess.h>
 
@@ -65,8 +66,6 @@ static struct super_block *alloc_super(void)
 			s = NULL;
 			goto out;
 		}
-		INIT_LIST_HEAD(&s->s_dirty);
-		INIT_LIST_HEAD(&s->s_io);
 		INIT_LIST_HEAD(&s->s_files);
 		INIT_LIST_HEAD(&s->s_instances);
 		INIT_HLIST_HEAD(&s->s_anon);
@@ -560,7 +559,7 @@ int do_remount_sb(struct super_block *sb, int flags, void *data, int force)
 	return 0;
 }
 
-static void do_emergency_remount(unsigned long foo)
+static void do_emergency_remount(void *unused)
 {
 	struct super_block *sb;
 
@@ -586,9 +585,11 @@ static void do_emergency_remount(unsigned long foo)
 	printk("Emergency Remount complete\n");
 }
 
+static DECLARE_WORK(emergency_remount_work, do_emergency_remount, NULL);
+
 void emergency_remount(void)
 {
-	pdflush_operation(do_emergency_remount, 0);
+	schedule_work(&emergency_remount_work);
 }
 
 /*
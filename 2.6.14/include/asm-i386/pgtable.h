@@ -450,6 +450,7 @@ extern void noexec_setup(const char *str);
 #define __HAVE_ARCH_PTEP_GET_AND_CLEAR_FULL
 #define __HAVE_ARCH_PTEP_SET_WRPROTECT
 #define __HAVE_ARCH_PTE_SAME
+#define __HAVE_ARCH_GET_USER_PAGES_FAST
 #include <asm-generic/pgtable.h>
 
 #endif /* _I386_PGTABLE_H */
@@ -3,6 +3,7 @@
 
 #include <linux/list.h>
 #include <linux/workqueue.h>
+#include <linux/uio.h>
 #include <linux/aio_abi.h>
 
 #include <asm/atomic.h>
@@ -32,6 +33,7 @@ struct kioctx;
 /* #define KIF_LOCKED		0 */
 #define KIF_KICKED		1
 #define KIF_CANCELLED		2
+#define KIF_WAITING		3	/* retry armed a wakeup, must not complete */
 
 #define kiocbTryLock(iocb)	test_and_set_bit(KIF_LOCKED, &(iocb)->ki_flags)
 #define kiocbTryKick(iocb)	test_and_set_bit(KIF_KICKED, &(iocb)->ki_flags)
@@ -43,10 +45,12 @@ struct kioctx;
 #define kiocbClearLocked(iocb)	clear_bit(KIF_LOCKED, &(iocb)->ki_flags)
 #define kiocbClearKicked(iocb)	clear_bit(KIF_KICKED, &(iocb)->ki_flags)
 #define kiocbClearCancelled(iocb)	clear_bit(KIF_CANCELLED, &(iocb)->ki_flags)
+#define kiocbClearWaiting(iocb)	clear_bit(KIF_WAITING, &(iocb)->ki_flags)
 
 #define kiocbIsLocked(iocb)	test_bit(KIF_LOCKED, &(iocb)->ki_flags)
 #define kiocbIsKicked(iocb)	test_bit(KIF_KICKED, &(iocb)->ki_flags)
 #define kiocbIsCancelled(iocb)	test_bit(KIF_CANCELLED, &(iocb)->ki_flags)
+#define kiocbIsWaiting(iocb)	test_bit(KIF_WAITING, &(iocb)->ki_flags)
 
 /* is there a better place to document function pointer methods? */
 /**
@@ -108,6 +112,10 @@ struct kiocb {
 	size_t			ki_nbytes; 	/* copy of iocb->aio_nbytes */
 	char 			__user *ki_buf;	/* remaining iocb->aio_buf */
 	size_t			ki_left; 	/* remaining bytes */
+	struct iovec		ki_inline_vec;	/* inline vector */
+	struct iovec		*ki_iovec;	/* IOCB_CMD_P{READ,WRITE}V */
+	unsigned long		ki_nr_segs;
+	unsigned long		ki_cur_seg;
 	wait_queue_t		ki_wait;
 	long			ki_retried; 	/* just for testing */
 	long			ki_kicked; 	/* just for testing */
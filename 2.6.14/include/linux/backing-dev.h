@@ -8,13 +8,18 @@
 #ifndef _LINUX_BACKING_DEV_H
 #define _LINUX_BACKING_DEV_H
 
+#include <linux/list.h>
+#include <linux/spinlock.h>
 #include <asm/atomic.h>
 
+struct task_struct;
+struct rw_semaphore;
+
 /*
  * Bits in backing_dev_info.state
  */
 enum bdi_state {
-	BDI_pdflush,		/* A pdflush thread is working this device */
+	BDI_writeback_running,	/* The flusher is writing this device */
 	BDI_write_congested,	/* The write queue is getting full */
 	BDI_read_congested,	/* The read queue is getting full */
 	BDI_unused,		/* Available bits start here */
@@ -22,6 +27,15 @@ enum bdi_state {
 
 typedef int (congested_fn)(void *, int);
 
+/*
+ * Per-device page counts, for the dirty throttling in page-writeback.c
+ */
+enum bdi_stat_item {
+	BDI_RECLAIMABLE,	/* dirty pages */
+	BDI_WRITEBACK,		/* pages under writeback */
+	NR_BDI_STAT_ITEMS
+};
+
 struct backing_dev_info {
 	unsigned long ra_pages;	/* max readahead in PAGE_CACHE_SIZE units */
 	unsigned long state;	/* Always use atomic bitops on this */
@@ -30,6 +44,21 @@ struct backing_dev_info {
 	void *congested_data;	/* Pointer to aux data for congested func */
 	void (*unplug_io_fn)(struct backing_dev_info *, struct page *);
 	void *unplug_io_data;
+
+	atomic_t bdi_stat[NR_BDI_STAT_ITEMS];
+	atomic_t completions;	/* recent writeout completions, decaying */
+	unsigned long completions_period; /* when completions was last aged */
+	int dirty_exceeded;	/* Dirty mem may be over this device's limit */
+
+	struct list_head bdi_list;	/* On bdi_list, once bdi_init()ed */
+	struct list_head b_dirty;	/* dirty inodes, newest first */
+	struct list_head b_io;		/* parked for writeback */
+
+	spinlock_t wb_lock;		/* protects work_list and wb_task */
+	struct list_head work_list;	/* writeback requests for the flusher */
+	struct task_struct *wb_task;	/* the flusher thread, if running */
+	unsigned long wb_last_active;	/* when the flusher last wrote a page */
+	unsigned long wb_last_old_flush; /* last kupdate-style writeback */
 };
 
 
@@ -61,6 +90,55 @@ struct backing_dev_info {
 extern struct backing_dev_info default_backing_dev_info;
 void default_unplug_io_fn(struct backing_dev_info *bdi, struct page *page);
 
+/* mm/backing-dev.c */
+extern struct list_head bdi_list;
+extern struct rw_semaphore bdi_list_sem;
+extern spinlock_t bdi_lock;
+
+void bdi_init(struct backing_dev_info *bdi);
+void bdi_destroy(struct backing_dev_info *bdi);
+void bdi_wakeup_flusher(struct backing_dev_info *bdi);
+void bdi_wakeup_flushers(void);
+void bdi_kick_forker(void);
+int bdi_forker_running(void);
+void bdi_start_flusher(struct backing_dev_info *bdi);
+
+/* fs/fs-writeback.c */
+int bdi_writeback_thread(void *data);
+long wb_do_writeback(struct backing_dev_info *bdi);
+
+static inline int bdi_has_dirty_io(struct backing_dev_info *bdi)
+{
+	return !list_empty(&bdi->b_dirty) || !list_empty(&bdi->b_io);
+}
+
+static inline int bdi_has_work(struct backing_dev_info *bdi)
+{
+	return !list_empty(&bdi->work_list);
+}
+
+static inline void inc_bdi_stat(struct backing_dev_info *bdi,
+				enum bdi_stat_item item)
+{
+	atomic_inc(&bdi->bdi_stat[item]);
+}
+
+static inline void dec_bdi_stat(struct backing_dev_info *bdi,
+				enum bdi_stat_item item)
+{
+	atomic_dec(&bdi->bdi_stat[item]);
+}
+
+static inline unsigned long bdi_stat(struct backing_dev_info *bdi,
+				     enum bdi_stat_item item)
+{
+	long val = atomic_read(&bdi->bdi_stat[item]);
+
+	return val < 0 ? 0 : val;
+}
+
+void bdi_writeout_inc(struct backing_dev_info *bdi);
+
 int writeback_acquire(struct backing_dev_info *bdi);
 int writeback_in_progress(struct backing_dev_info *bdi);
 void writeback_release(struct backing_dev_info *bdi);
@@ -253,6 +253,12 @@ extern void __init mnt_init(unsigned long);
 extern void __init files_init(unsigned long);
 
 struct buffer_head;
+/*
+ * Map file block @iblock into @bh_result.  On entry b_size is how much the
+ * caller would like mapped.  A filesystem that finds a contiguous run of
+ * blocks may map up to that much and return the length mapped in b_size.
+ * map_bh() sets b_size to a single block, which is always a valid answer.
+ */
 typedef int (get_block_t)(struct inode *inode, sector_t iblock,
 			struct buffer_head *bh_result, int create);
 typedef int (get_blocks_t)(struct inode *inode, sector_t iblock,
@@ -331,6 +337,18 @@ struct address_space_operations {
 	 */
 	int (*prepare_write)(struct file *, struct page *, unsigned, unsigned);
 	int (*commit_write)(struct file *, struct page *, unsigned, unsigned);
+	/*
+	 * The same for a write spanning several locked, consecutive pages:
+	 * it starts at offset @from in the first and ends at @to in the last.
+	 * prepare_write_pages returns how many of the pages it prepared, or
+	 * -errno if it could not prepare even the first one.  commit_write_pages
+	 * is called on all of those, with the number of bytes actually copied
+	 * in from @from, and returns how many of them it kept, or -errno.
+	 */
+	int (*prepare_write_pages)(struct file *, struct page **, unsigned,
+				   unsigned, unsigned);
+	int (*commit_write_pages)(struct file *, struct page **, unsigned,
+				  unsigned, unsigned, unsigned);
 	/* Unfortunately this kludge is needed for FIBMAP. Don't use it */
 	sector_t (*bmap)(struct address_space *, sector_t);
 	int (*invalidatepage) (struct page *, unsigned long);
@@ -339,6 +357,11 @@ struct address_space_operations {
 			loff_t offset, unsigned long nr_segs);
 	struct page* (*get_xip_page)(struct address_space *, sector_t,
 			int);
+	/*
+	 * A read-only mapped page of a shared writable mapping is about to
+	 * be written to.  Returns 0, or -errno to make the fault SIGBUS.
+	 */
+	int (*page_mkwrite)(struct file *, struct page *);
 };
 
 struct backing_dev_info;
@@ -625,20 +648,12 @@ struct fown_struct {
  * Track a single file's readahead state
  */
 struct file_ra_state {
-	/*当前窗内第一页的索引*/
-	unsigned long start;		/* Current window */
-	/*当前窗内的页数（当临时禁止预读时为-1,0表示当前窗空）*/
-	unsigned long size;
-	/*控制预读的一些标志,重要标志如RA_FLAG_MISS和RA_FLAG_INCACHE*/
-	unsigned long flags;		/* ra flags RA_FLAG_xxx*/
-	/*连续高速缓存命中数（进程请求的页同时又在页高速缓存内）*/
-	unsigned long cache_hit;	/* cache hit count*/
+	unsigned long start;		/* where the last readahead started */
+	unsigned long size;		/* # of pages it read */
+	unsigned long async_size;	/* start the next one when only this
+					   many of them are left unread */
 	/*进程上一次读操作中所请求页的最后一页的索引,初值是-1*/
 	unsigned long prev_page;	/* Cache last read() position */
-	/*预读窗内第一页的索引*/
-	unsigned long ahead_start;	/* Ahead window */
-	/*预读窗的页数（0表示预读窗口空）*/
-	unsigned long ahead_size;
 	/*
 	 * 预读窗的最大页数（0表示预读窗永久禁止),对该文件允许最大预读量
 	 * 缺省的初始值存放在文件所在块设备的blocking_dev_info描述符中
@@ -650,10 +665,6 @@ struct file_ra_state {
 	/*预读失败计数器（用于内存映射文件）*/
 	unsigned long mmap_miss;	/* Cache miss stat for mmap accesses */
 };
-/*如果已被预读的页不在缓存中（可能由于内存回收）*/
-#define RA_FLAG_MISS 0x01	/* a cache miss occured against this file */
-/*当内核确定进程请求的最后256页都在页高速缓存内*/
-#define RA_FLAG_INCACHE 0x02	/* file is already in cache */
 
 struct file {
 	/*
@@ -898,10 +909,6 @@ struct super_block {
 	struct xattr_handler	**s_xattr;
 
 	struct list_head	s_inodes;	/* all inodes */
-	/*集中了超级快的脏的inode节点*/
-	struct list_head	s_dirty;	/* dirty inodes */
-	/*集中了等待被传输到磁盘的inode节点*/
-	struct list_head	s_io;		/* parked for writeback */
 	struct hlist_head	s_anon;		/* anonymous dentries for (nfs) exporting */
 	/*文件对象的链表*/
 	struct list_head	s_files;
@@ -1078,6 +1085,8 @@ typedef int (*read_actor_t)(read_descriptor_t *, struct page *, unsigned long, u
  * read, write, poll, fsync, readv, writev, unlocked_ioctl and compat_ioctl
  * can be called without the big kernel lock held in all filesystems.
  */
+struct splice_pipe;
+
 struct file_operations {
 	struct module *owner;
 	loff_t (*llseek) (struct file *, loff_t, int);
@@ -1085,6 +1094,8 @@ struct file_operations {
 	ssize_t (*aio_read) (struct kiocb *, char __user *, size_t, loff_t);
 	ssize_t (*write) (struct file *, const char __user *, size_t, loff_t *);
 	ssize_t (*aio_write) (struct kiocb *, const char __user *, size_t, loff_t);
+	ssize_t (*aio_readv) (struct kiocb *, const struct iovec *, unsigned long, loff_t);
+	ssize_t (*aio_writev) (struct kiocb *, const struct iovec *, unsigned long, loff_t);
 	int (*readdir) (struct file *, void *, filldir_t);
 	unsigned int (*poll) (struct file *, struct poll_table_struct *);
 	int (*ioctl) (struct inode *, struct file *, unsigned int, unsigned long);
@@ -1102,6 +1113,8 @@ struct file_operations {
 	ssize_t (*writev) (struct file *, const struct iovec *, unsigned long, loff_t *);
 	ssize_t (*sendfile) (struct file *, loff_t *, size_t, read_actor_t, void *);
 	ssize_t (*sendpage) (struct file *, struct page *, int, size_t, loff_t *, int);
+	ssize_t (*splice_read) (struct file *, loff_t *, struct splice_pipe *, size_t, unsigned int);
+	ssize_t (*splice_write) (struct splice_pipe *, struct file *, loff_t *, size_t, unsigned int);
 	unsigned long (*get_unmapped_area)(struct file *, unsigned long, unsigned long, unsigned long, unsigned long);
 	int (*check_flags)(int);
 	int (*dir_notify)(struct file *filp, unsigned long arg);
@@ -1524,6 +1537,13 @@ extern int filemap_fdatawait(struct address_space *);
 extern int filemap_write_and_wait(struct address_space *mapping);
 extern int filemap_write_and_wait_range(struct address_space *mapping,
 				        loff_t lstart, loff_t lend);
+
+/* sync_file_range() flags */
+#define SYNC_FILE_RANGE_WAIT_BEFORE	1	/* wait for writeout already in flight */
+#define SYNC_FILE_RANGE_WRITE		2	/* start writeout of dirty pages */
+#define SYNC_FILE_RANGE_WAIT_AFTER	4	/* wait for the writeout to finish */
+extern int do_sync_mapping_range(struct address_space *mapping, loff_t offset,
+				 loff_t endbyte, unsigned int flags);
 extern void sync_supers(void);
 extern void sync_filesystems(int wait);
 extern void emergency_sync(void);
@@ -1631,12 +1651,16 @@ extern ssize_t generic_file_write(struct file *, const char __user *, size_t, lo
 extern ssize_t generic_file_aio_read(struct kiocb *, char __user *, size_t, loff_t);
 extern ssize_t __generic_file_aio_read(struct kiocb *, const struct iovec *, unsigned long, loff_t *);
 extern ssize_t generic_file_aio_write(struct kiocb *, const char __user *, size_t, loff_t);
+extern ssize_t generic_file_aio_readv(struct kiocb *, const struct iovec *, unsigned long, loff_t);
+extern ssize_t generic_file_aio_writev(struct kiocb *, const struct iovec *, unsigned long, loff_t);
 extern ssize_t generic_file_aio_write_nolock(struct kiocb *, const struct iovec *,
 		unsigned long, loff_t *);
 extern ssize_t generic_file_direct_write(struct kiocb *, const struct iovec *,
 		unsigned long *, loff_t, loff_t *, size_t, size_t);
 extern ssize_t generic_file_buffered_write(struct kiocb *, const struct iovec *,
 		unsigned long, loff_t, loff_t *, size_t, ssize_t);
+extern ssize_t generic_file_write_page(struct file *, struct page *,
+		unsigned long, size_t, loff_t *);
 extern ssize_t do_sync_read(struct file *filp, char __user *buf, size_t len, loff_t *ppos);
 extern ssize_t do_sync_write(struct file *filp, const char __user *buf, size_t len, loff_t *ppos);
 ssize_t generic_file_write_nolock(struct file *file, const struct iovec *iov,
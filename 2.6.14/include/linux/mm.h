@@ -312,6 +312,13 @@ struct vm_operations_struct {
 	struct page * (*nopage)(struct vm_area_struct * area, unsigned long address, int *type);
 	/*设置线性区的线性地址所对应的页表项时调用，主要用于非线性文件内存映射???*/
 	int (*populate)(struct vm_area_struct * area, unsigned long address, unsigned long len, pgprot_t prot, unsigned long pgoff, int nonblock);
+	/*
+	 * Map the pages of [start_pgoff, end_pgoff] that are already cached
+	 * and uptodate around a read fault, starting at @address and @pte.
+	 * Called with the pte lock held, so it must not sleep or start I/O.
+	 */
+	void (*map_pages)(struct vm_area_struct *area, unsigned long address,
+			pte_t *pte, pgoff_t start_pgoff, pgoff_t end_pgoff);
 #ifdef CONFIG_NUMA
 	int (*set_policy)(struct vm_area_struct *vma, struct mempolicy *new);
 	struct mempolicy *(*get_policy)(struct vm_area_struct *vma,
@@ -718,6 +725,9 @@ static inline void set_page_links(struct page *page, unsigned long zone,
 	set_page_section(page, pfn_to_section_nr(pfn));
 }
 
+/* the zone counters need page_zone() */
+#include <linux/vmstat.h>
+
 #ifndef CONFIG_DISCONTIGMEM
 /* The array of struct pages - for discontigmem use pgdat->lmem_map */
 extern struct page *mem_map;
@@ -825,6 +835,12 @@ static inline int page_mapped(struct page *page)
  */
 #define NOPAGE_SIGBUS	(NULL)
 #define NOPAGE_OOM	((struct page *) (-1))
+/*
+ * ->nopage() is entered with *type == VM_FAULT_RETRY when the fault may be
+ * retried.  Rather than wait for I/O with mmap_sem held, it may then drop
+ * mmap_sem, wait, and return NOPAGE_RETRY.
+ */
+#define NOPAGE_RETRY	((struct page *) (-2))
 
 /*
  * Different kinds of faults, as returned by handle_mm_fault().
@@ -835,6 +851,7 @@ static inline int page_mapped(struct page *page)
 #define VM_FAULT_SIGBUS	0x01
 #define VM_FAULT_MINOR	0x02
 #define VM_FAULT_MAJOR	0x03
+#define VM_FAULT_RETRY	0x04	/* mmap_sem was dropped, fault again */
 
 /* 
  * Special case for get_user_pages.
@@ -842,6 +859,12 @@ static inline int page_mapped(struct page *page)
  */
 #define VM_FAULT_WRITE	0x10
 
+/*
+ * Flags for the write_access argument of handle_mm_fault().
+ */
+#define FAULT_FLAG_WRITE	0x01	/* the fault was a write */
+#define FAULT_FLAG_ALLOW_RETRY	0x08	/* may return VM_FAULT_RETRY */
+
 #define offset_in_page(p)	((unsigned long)(p) & ~PAGE_MASK)
 
 extern void show_free_areas(void);
@@ -913,6 +936,9 @@ extern int vmtruncate(struct inode * inode, loff_t offset);
 extern int install_page(struct mm_struct *mm, struct vm_area_struct *vma, unsigned long addr, struct page *page, pgprot_t prot);
 extern int install_file_pte(struct mm_struct *mm, struct vm_area_struct *vma, unsigned long addr, unsigned long pgoff, pgprot_t prot);
 extern int __handle_mm_fault(struct mm_struct *mm,struct vm_area_struct *vma, unsigned long address, int write_access);
+extern void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		struct page *page, pte_t *pte, int write, int anon);
+extern int fault_around_pages;
 
 /*
  * 为vma的address分配一个新页表项和页框
@@ -921,6 +947,9 @@ extern int __handle_mm_fault(struct mm_struct *mm,struct vm_area_struct *vma, un
  * @vma: 引起异常的线性地址所在线性区的描述符
  * @address: 引起异常的线性地址
  * @write_access: 如果task试图向address写，则置为1，如果task试图在address读或执行，则置为0
+ *
+ * With FAULT_FLAG_ALLOW_RETRY in @write_access the fault may return
+ * VM_FAULT_RETRY, in which case mmap_sem has been released.
  */
 static inline int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma, unsigned long address, int write_access)
 {
@@ -933,6 +962,8 @@ void install_arg_page(struct vm_area_struct *, struct page *, unsigned long);
 
 int get_user_pages(struct task_struct *tsk, struct mm_struct *mm, unsigned long start,
 		int len, int write, int force, struct page **pages, struct vm_area_struct **vmas);
+int get_user_pages_fast(unsigned long start, int nr_pages, int write,
+			struct page **pages);
 void print_bad_pte(struct vm_area_struct *, pte_t, unsigned long);
 
 int __set_page_dirty_buffers(struct page *page);
@@ -941,7 +972,9 @@ int redirty_page_for_writepage(struct writeback_control *wbc,
 				struct page *page);
 int FASTCALL(set_page_dirty(struct page *page));
 int set_page_dirty_lock(struct page *page);
+void set_page_dirty_balance(struct page *page);
 int clear_page_dirty_for_io(struct page *page);
+int page_mkclean(struct page *page);
 
 extern unsigned long do_mremap(unsigned long addr,
 			       unsigned long old_len, unsigned long new_len,
@@ -1105,6 +1138,7 @@ extern unsigned long get_unmapped_area(struct file *, unsigned long, unsigned lo
 extern unsigned long do_mmap_pgoff(struct file *file, unsigned long addr,
 	unsigned long len, unsigned long prot,
 	unsigned long flag, unsigned long pgoff);
+extern int vma_wants_writenotify(struct vm_area_struct *vma);
 
 /*
  * 文件映射或匿名映射,如果是匿名映射则file与pgoff为空
@@ -1141,6 +1175,8 @@ extern void truncate_inode_pages(struct address_space *, loff_t);
 extern struct page *filemap_nopage(struct vm_area_struct *, unsigned long, int *);
 extern int filemap_populate(struct vm_area_struct *, unsigned long,
 		unsigned long, pgprot_t, unsigned long, int);
+extern void filemap_map_pages(struct vm_area_struct *, unsigned long,
+		pte_t *, pgoff_t, pgoff_t);
 
 /* mm/page-writeback.c */
 int write_one_page(struct page *page, int wait);
@@ -1148,20 +1184,22 @@ int write_one_page(struct page *page, int wait);
 /* readahead.c */
 #define VM_MAX_READAHEAD	128	/* kbytes */
 #define VM_MIN_READAHEAD	16	/* kbytes (includes current page) */
-#define VM_MAX_CACHE_HIT    	256	/* max pages in a row in cache before
-					 * turning readahead off */
 
 int do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 			unsigned long offset, unsigned long nr_to_read);
 int force_page_cache_readahead(struct address_space *mapping, struct file *filp,
 			unsigned long offset, unsigned long nr_to_read);
-unsigned long  page_cache_readahead(struct address_space *mapping,
-			  struct file_ra_state *ra,
-			  struct file *filp,
-			  unsigned long offset,
-			  unsigned long size);
-void handle_ra_miss(struct address_space *mapping, 
-		    struct file_ra_state *ra, pgoff_t offset);
+void page_cache_sync_readahead(struct address_space *mapping,
+			       struct file_ra_state *ra,
+			       struct file *filp,
+			       pgoff_t offset,
+			       unsigned long req_size);
+void page_cache_async_readahead(struct address_space *mapping,
+				struct file_ra_state *ra,
+				struct file *filp,
+				struct page *page,
+				pgoff_t offset,
+				unsigned long req_size);
 unsigned long max_sane_readahead(unsigned long nr);
 
 /* Do stack extension */
@@ -46,6 +46,23 @@ struct zone_padding {
 #define ZONE_PADDING(name)
 #endif
 
+/*
+ * Page counts kept per zone.  Each CPU holds a small difference against the
+ * zone and global counters (vm_stat_diff) and only folds it in when it goes
+ * past stat_threshold, so the counters can be read without summing over all
+ * CPUs.  The names in /proc/vmstat (vmstat_text) follow this order.
+ */
+enum zone_stat_item {
+	NR_FILE_DIRTY,		/* Dirty writeable pages */
+	NR_WRITEBACK,		/* Pages under writeback */
+	NR_UNSTABLE_NFS,	/* NFS unstable pages */
+	NR_PAGETABLE,		/* Pages used for pagetables */
+	NR_MAPPED,		/* mapped into pagetables */
+	NR_SLAB,		/* In slab */
+	NR_FILE_PAGES,		/* In the pagecache, swapcache included */
+	NR_BOUNCE,		/* Bounce buffers */
+	NR_VM_ZONE_STAT_ITEMS };
+
 struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int low;		/* low watermark, refill needed */
@@ -57,6 +74,10 @@ struct per_cpu_pages {
 struct per_cpu_pageset {
 	/*hot高速缓存存放的页框中包含内容很可能在硬件cache*/
 	struct per_cpu_pages pcp[2];	/* 0: hot.  1: cold */
+#ifdef CONFIG_SMP
+	s8 stat_threshold;
+	s8 vm_stat_diff[NR_VM_ZONE_STAT_ITEMS];
+#endif
 #ifdef CONFIG_NUMA
 	unsigned long numa_hit;		/* allocated in intended node */
 	unsigned long numa_miss;	/* allocated in non intended node */
@@ -211,6 +232,9 @@ struct zone {
 	/*上次执行扫描的优先级*/
 	int prev_priority;
 
+	/* Zone statistics, less whatever the CPUs still hold in vm_stat_diff */
+	atomic_t		vm_stat[NR_VM_ZONE_STAT_ITEMS];
+
 
 	ZONE_PADDING(_pad2_)
 	/* Rarely used or read-mostly fields */
@@ -99,49 +99,14 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 extern void remove_from_page_cache(struct page *page);
 extern void __remove_from_page_cache(struct page *page);
 
-extern atomic_t nr_pagecache;
-
-#ifdef CONFIG_SMP
-
-#define PAGECACHE_ACCT_THRESHOLD        max(16, NR_CPUS * 2)
-DECLARE_PER_CPU(long, nr_pagecache_local);
-
 /*
- * pagecache_acct implements approximate accounting for pagecache.
- * vm_enough_memory() do not need high accuracy. Writers will keep
- * an offset in their per-cpu arena and will spill that into the
- * global count whenever the absolute value of the local count
- * exceeds the counter's threshold.
- *
- * MUST be protected from preemption.
- * current protection is mapping->page_lock.
+ * The number of pages in the pagecache, swapcache included.  As approximate
+ * as the zone counters it is read from, which is good enough for
+ * vm_enough_memory().
  */
-static inline void pagecache_acct(int count)
-{
-	long *local;
-
-	local = &__get_cpu_var(nr_pagecache_local);
-	*local += count;
-	if (*local > PAGECACHE_ACCT_THRESHOLD || *local < -PAGECACHE_ACCT_THRESHOLD) {
-		atomic_add(*local, &nr_pagecache);
-		*local = 0;
-	}
-}
-
-#else
-
-static inline void pagecache_acct(int count)
-{
-	atomic_add(count, &nr_pagecache);
-}
-#endif
-
 static inline unsigned long get_page_cache_size(void)
 {
-	int ret = atomic_read(&nr_pagecache);
-	if (unlikely(ret < 0))
-		ret = 0;
-	return ret;
+	return global_page_state(NR_FILE_PAGES);
 }
 
 /*
@@ -171,6 +136,13 @@ static inline void lock_page(struct page *page)
 	if (TestSetPageLocked(page))
 		__lock_page(page);
 }
+
+/*
+ * For AIO retries: return -EIOCBRETRY instead of sleeping when running on
+ * behalf of a kiocb; the kiocb is kicked once the page bit clears.
+ */
+extern int FASTCALL(wait_on_page_bit_async(struct page *page, int bit_nr));
+extern int FASTCALL(lock_page_async(struct page *page));
 	
 /*
  * This is exported only for wait_on_page_locked/wait_on_page_writeback.
@@ -0,0 +1,54 @@
+#ifndef _LINUX_SPLICE_H
+#define _LINUX_SPLICE_H
+
+/*
+ * Moving data between files without copying it through user space.
+ */
+
+#include <linux/fs.h>
+
+#define SPLICE_BUFFERS	16
+
+/*
+ * A splice buffer carries a reference on (part of) a page rather than a
+ * copy of its contents.  For page cache pages the data is whatever the page
+ * holds when the buffer is consumed.
+ */
+struct splice_buffer {
+	struct page	*page;
+	unsigned int	offset;
+	unsigned int	len;
+};
+
+/*
+ * A small ring of splice buffers.  ->splice_read() appends buffers at
+ * curbuf + nrbufs, ->splice_write() consumes them from curbuf.
+ */
+struct splice_pipe {
+	struct splice_buffer	bufs[SPLICE_BUFFERS];
+	unsigned int		curbuf;
+	unsigned int		nrbufs;
+};
+
+/* flags for do_splice_direct() and the ->splice_{read,write} methods */
+#define SPLICE_F_NONBLOCK	(0x02)	/* don't block on the destination */
+#define SPLICE_F_MORE		(0x04)	/* expect more data */
+
+static inline void splice_pipe_init(struct splice_pipe *pipe)
+{
+	pipe->curbuf = 0;
+	pipe->nrbufs = 0;
+}
+
+extern void splice_pipe_release(struct splice_pipe *);
+
+extern ssize_t generic_file_splice_read(struct file *, loff_t *,
+		struct splice_pipe *, size_t, unsigned int);
+extern ssize_t generic_file_splice_write(struct splice_pipe *, struct file *,
+		loff_t *, size_t, unsigned int);
+extern ssize_t generic_splice_sendpage(struct splice_pipe *, struct file *,
+		loff_t *, size_t, unsigned int);
+extern long do_splice_direct(struct file *, loff_t *, struct file *, loff_t *,
+		size_t, unsigned int);
+
+#endif /* _LINUX_SPLICE_H */
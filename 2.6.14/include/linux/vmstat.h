@@ -0,0 +1,115 @@
+#ifndef _LINUX_VMSTAT_H
+#define _LINUX_VMSTAT_H
+
+/*
+ * Zone based page accounting.
+ *
+ * Every zone keeps its own count of each zone_stat_item, and vm_stat[] has
+ * the machine-wide totals.  On SMP each CPU accumulates its changes in the
+ * zone's per_cpu_pageset and only touches the shared atomics when the
+ * difference passes the pageset's stat_threshold, or when
+ * refresh_cpu_vm_stats() folds it in.  So reading a counter is a single
+ * atomic_read, and the result is off by at most
+ * num_online_cpus() * stat_threshold per zone.
+ */
+
+#include <linux/config.h>
+#include <linux/mmzone.h>
+#include <asm/atomic.h>
+
+extern atomic_t vm_stat[NR_VM_ZONE_STAT_ITEMS];
+
+static inline void zone_page_state_add(long x, struct zone *zone,
+				 enum zone_stat_item item)
+{
+	atomic_add(x, &zone->vm_stat[item]);
+	atomic_add(x, &vm_stat[item]);
+}
+
+static inline unsigned long global_page_state(enum zone_stat_item item)
+{
+	long x = atomic_read(&vm_stat[item]);
+#ifdef CONFIG_SMP
+	/* The CPUs may still hold the increments that made up for this */
+	if (x < 0)
+		x = 0;
+#endif
+	return x;
+}
+
+static inline unsigned long zone_page_state(struct zone *zone,
+					enum zone_stat_item item)
+{
+	long x = atomic_read(&zone->vm_stat[item]);
+#ifdef CONFIG_SMP
+	if (x < 0)
+		x = 0;
+#endif
+	return x;
+}
+
+#ifdef CONFIG_NUMA
+extern unsigned long node_page_state(int node, enum zone_stat_item item);
+#else
+#define node_page_state(node, item) global_page_state(item)
+#endif
+
+static inline void zap_zone_vm_stats(struct zone *zone)
+{
+	int i;
+
+	for (i = 0; i < NR_VM_ZONE_STAT_ITEMS; i++)
+		atomic_set(&zone->vm_stat[i], 0);
+}
+
+#ifdef CONFIG_SMP
+/*
+ * The __ variants must be called with preemption disabled, and only for
+ * counters that are never changed from interrupt context or with interrupts
+ * disabled.  The others can be used anywhere.
+ */
+void __mod_zone_page_state(struct zone *, enum zone_stat_item item, int);
+void __inc_zone_page_state(struct page *, enum zone_stat_item);
+void __dec_zone_page_state(struct page *, enum zone_stat_item);
+
+void mod_zone_page_state(struct zone *, enum zone_stat_item, int);
+void inc_zone_page_state(struct page *, enum zone_stat_item);
+void dec_zone_page_state(struct page *, enum zone_stat_item);
+
+extern void refresh_cpu_vm_stats(int cpu);
+#else
+/*
+ * Without per-CPU differences the atomics are updated directly, which is
+ * safe from any context.
+ */
+static inline void __mod_zone_page_state(struct zone *zone,
+			enum zone_stat_item item, int delta)
+{
+	zone_page_state_add(delta, zone, item);
+}
+
+static inline void __inc_zone_page_state(struct page *page,
+			enum zone_stat_item item)
+{
+	zone_page_state_add(1, page_zone(page), item);
+}
+
+static inline void __dec_zone_page_state(struct page *page,
+			enum zone_stat_item item)
+{
+	zone_page_state_add(-1, page_zone(page), item);
+}
+
+#define mod_zone_page_state __mod_zone_page_state
+#define inc_zone_page_state __inc_zone_page_state
+#define dec_zone_page_state __dec_zone_page_state
+
+static inline void refresh_cpu_vm_stats(int cpu) { }
+#endif
+
+#define add_zone_page_state(__z, __i, __d)	\
+		mod_zone_page_state(__z, __i, __d)
+#define sub_zone_page_state(__z, __i, __d)	\
+		mod_zone_page_state(__z, __i, -(__d))
+
+#endif /* _LINUX_VMSTAT_H */
@@ -14,12 +14,12 @@ extern struct list_head inode_unused;
  * Yes, writeback.h requires sched.h
  * No, sched.h is not included from here.
  */
-static inline int task_is_pdflush(struct task_struct *task)
+static inline int task_is_flusher(struct task_struct *task)
 {
 	return task->flags & PF_FLUSHER;
 }
 
-#define current_is_pdflush()	task_is_pdflush(current)
+#define current_is_flusher()	task_is_flusher(current)
 
 /*
  * fs/fs-writeback.c
@@ -27,7 +27,7 @@ static inline int task_is_pdflush(struct task_struct *task)
 enum writeback_sync_modes {
 	WB_SYNC_NONE,	/* Don't wait on anything */
 	WB_SYNC_ALL,	/* Wait on every mapping */
-	WB_SYNC_HOLD,	/* Hold the inode on sb_dirty for sys_sync() */
+	WB_SYNC_HOLD,	/* Hold the inode on b_dirty for sys_sync() */
 };
 
 /*
@@ -72,7 +72,10 @@ struct writeback_control {
 /*
  * fs/fs-writeback.c
  */	
-void writeback_inodes(struct writeback_control *wbc);
+void wakeup_flusher_threads(long nr_pages);
+void bdi_start_writeback(struct backing_dev_info *bdi, long nr_pages);
+long bdi_sync_writeback(struct backing_dev_info *bdi, struct super_block *sb,
+			long nr_pages, enum writeback_sync_modes sync_mode);
 void wake_up_inode(struct inode *inode);
 int inode_wait(void *);
 void sync_inodes_sb(struct super_block *, int wait);
@@ -89,10 +92,12 @@ static inline void wait_on_inode(struct inode *inode)
 /*
  * mm/page-writeback.c
  */
-int wakeup_pdflush(long nr_pages);
 void laptop_io_completion(void);
 void laptop_sync_completion(void);
 void throttle_vm_writeout(void);
+int over_bground_thresh(void);
+void get_bdi_dirty_limits(struct backing_dev_info *bdi, long *pbackground,
+			  long *pdirty, long *pbdi_dirty);
 
 /* These are exported to sysctl. */
 extern int dirty_background_ratio;
@@ -106,17 +111,26 @@ struct ctl_table;
 struct file;
 int dirty_writeback_centisecs_handler(struct ctl_table *, int, struct file *,
 				      void __user *, size_t *, loff_t *);
+int dirty_ratio_handler(struct ctl_table *, int, struct file *,
+			void __user *, size_t *, loff_t *);
 
 void page_writeback_init(void);
-void balance_dirty_pages_ratelimited(struct address_space *mapping);
-int pdflush_operation(void (*fn)(unsigned long), unsigned long arg0);
+void balance_dirty_pages_ratelimited_nr(struct address_space *mapping,
+					unsigned long nr_pages_dirtied);
+
+static inline void
+balance_dirty_pages_ratelimited(struct address_space *mapping)
+{
+	balance_dirty_pages_ratelimited_nr(mapping, 1);
+}
+
 int do_writepages(struct address_space *mapping, struct writeback_control *wbc);
 int sync_page_range(struct inode *inode, struct address_space *mapping,
 			loff_t pos, size_t count);
 
-/* pdflush.c */
-extern int nr_pdflush_threads;	/* Global so it can be exported to sysctl
-				   read-only. */
+/* backing-dev.c */
+extern int nr_pdflush_threads;	/* Running flusher threads.  Global so it can
+				   be exported to sysctl read-only. */
 
 
 #endif		/* WRITEBACK_H */
@@ -1551,6 +1551,7 @@ int __init cpuset_init(void)
 
 	init_task.cpuset = &top_cpuset;
 
+	bdi_init(&cpuset_backing_dev_info);
 	err = register_filesystem(&cpuset_fs_type);
 	if (err < 0)
 		goto out;
@@ -0,0 +1,300 @@
+/*
+ * mm/backing-dev.c - backing devices and their flusher threads
+ *
+ * Every backing device that takes writeback gets a flusher thread of its
+ * own (bdi_writeback_thread() in fs/fs-writeback.c), which owns the
+ * device's dirty inode lists and does all of its background, kupdate and
+ * requested writeback.  So a congested device only ever holds up its own
+ * writeback, and there are as many flushers as there are busy devices.
+ *
+ * The flushers are started when a device first has dirty inodes or is
+ * handed work, and stopped again after they have been idle for a while.
+ * That is done by a single "bdi-default" thread, because the places that
+ * find a device needing a flusher usually cannot sleep.
+ */
+
+#include <linux/sched.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/rwsem.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/writeback.h>
+#include <linux/backing-dev.h>
+#include <linux/kthread.h>
+#include <asm/semaphore.h>
+
+/*
+ * All devices set up with bdi_init().  Changing the list takes both locks.
+ * Walkers that sleep (sync, the forker) hold bdi_list_sem; the ones that
+ * may be called from page reclaim must not wait for those, and take
+ * bdi_lock instead.  The devices' dirty inode lists are under inode_lock.
+ */
+LIST_HEAD(bdi_list);
+DECLARE_RWSEM(bdi_list_sem);
+DEFINE_SPINLOCK(bdi_lock);
+
+/*
+ * The count of currently-running flusher threads.  Protected by bdi_lock.
+ *
+ * Readable by sysctl, but not writable.  Published to userspace at
+ * /proc/sys/vm/nr_pdflush_threads.
+ */
+int nr_pdflush_threads = 0;
+
+/*
+ * A flusher that has written nothing for this long, and has no dirty
+ * inodes left, is stopped.
+ */
+#define BDI_FLUSHER_IDLE	(5 * 60 * HZ)
+
+static struct task_struct *bdi_forker_task;
+static unsigned long bdi_forker_kicked;
+
+/* Serializes starting flushers, which the forker and waiters both do */
+static DECLARE_MUTEX(bdi_start_sem);
+
+/**
+ * bdi_init - set up a backing_dev_info for writeback
+ * @bdi: the device
+ *
+ * Must be called before any inode backed by @bdi can be dirtied.
+ */
+void bdi_init(struct backing_dev_info *bdi)
+{
+	INIT_LIST_HEAD(&bdi->b_dirty);
+	INIT_LIST_HEAD(&bdi->b_io);
+	INIT_LIST_HEAD(&bdi->work_list);
+	spin_lock_init(&bdi->wb_lock);
+	bdi->wb_task = NULL;
+	bdi->wb_last_active = jiffies;
+	bdi->wb_last_old_flush = jiffies;
+
+	down_write(&bdi_list_sem);
+	spin_lock(&bdi_lock);
+	list_add_tail(&bdi->bdi_list, &bdi_list);
+	spin_unlock(&bdi_lock);
+	up_write(&bdi_list_sem);
+}
+EXPORT_SYMBOL(bdi_init);
+
+/*
+ * Stop @bdi's flusher.  Unless @force, not if it has been given work
+ * meanwhile.
+ */
+static void bdi_stop_flusher(struct backing_dev_info *bdi, int force)
+{
+	struct task_struct *task = NULL;
+
+	spin_lock(&bdi->wb_lock);
+	if (force || !bdi_has_work(bdi)) {
+		task = bdi->wb_task;
+		bdi->wb_task = NULL;
+	}
+	spin_unlock(&bdi->wb_lock);
+
+	if (task) {
+		kthread_stop(task);
+		spin_lock(&bdi_lock);
+		nr_pdflush_threads--;
+		spin_unlock(&bdi_lock);
+	}
+}
+
+/*
+ * Move the inodes on @list over to default_backing_dev_info's b_dirty.
+ * Their mappings are pointed there as well: the inodes outlive @bdi, and
+ * are put back on their device's lists through the mapping when redirtied
+ * or written.  Called under inode_lock.
+ */
+static void bdi_move_inodes(struct backing_dev_info *bdi,
+			    struct list_head *list)
+{
+	struct inode *inode;
+
+	list_for_each_entry(inode, list, i_list) {
+		if (inode->i_mapping->backing_dev_info == bdi)
+			inode->i_mapping->backing_dev_info =
+						&default_backing_dev_info;
+	}
+	list_splice_init(list, &default_backing_dev_info.b_dirty);
+}
+
+/**
+ * bdi_destroy - tear down a backing_dev_info
+ * @bdi: the device
+ *
+ * Stops the flusher and hands any inodes still dirty against @bdi over to
+ * default_backing_dev_info, so that they do not go away with it.
+ */
+void bdi_destroy(struct backing_dev_info *bdi)
+{
+	down_write(&bdi_list_sem);
+	spin_lock(&bdi_lock);
+	list_del(&bdi->bdi_list);
+	spin_unlock(&bdi_lock);
+	up_write(&bdi_list_sem);
+
+	/* Whatever was asked of the flusher and not done yet is done here */
+	bdi_stop_flusher(bdi, 1);
+	if (bdi_has_work(bdi))
+		wb_do_writeback(bdi);
+
+	spin_lock(&inode_lock);
+	bdi_move_inodes(bdi, &bdi->b_io);
+	bdi_move_inodes(bdi, &bdi->b_dirty);
+	spin_unlock(&inode_lock);
+}
+EXPORT_SYMBOL(bdi_destroy);
+
+/**
+ * bdi_kick_forker - get flushers started for devices that need them
+ *
+ * Can be called from any context.
+ */
+void bdi_kick_forker(void)
+{
+	set_bit(0, &bdi_forker_kicked);
+	if (bdi_forker_task)
+		wake_up_process(bdi_forker_task);
+}
+
+int bdi_forker_running(void)
+{
+	return bdi_forker_task != NULL;
+}
+
+/**
+ * bdi_wakeup_flusher - wake a device's flusher, starting one if need be
+ * @bdi: the device
+ */
+void bdi_wakeup_flusher(struct backing_dev_info *bdi)
+{
+	spin_lock(&bdi->wb_lock);
+	if (bdi->wb_task)
+		wake_up_process(bdi->wb_task);
+	else
+		bdi_kick_forker();
+	spin_unlock(&bdi->wb_lock);
+}
+EXPORT_SYMBOL(bdi_wakeup_flusher);
+
+/**
+ * bdi_wakeup_flushers - wake all flushers
+ *
+ * So that they notice a change in the writeback tunables.
+ */
+void bdi_wakeup_flushers(void)
+{
+	struct backing_dev_info *bdi;
+
+	spin_lock(&bdi_lock);
+	list_for_each_entry(bdi, &bdi_list, bdi_list) {
+		spin_lock(&bdi->wb_lock);
+		if (bdi->wb_task)
+			wake_up_process(bdi->wb_task);
+		spin_unlock(&bdi->wb_lock);
+	}
+	spin_unlock(&bdi_lock);
+	bdi_kick_forker();
+}
+
+/**
+ * bdi_start_flusher - start a device's flusher unless it has one
+ * @bdi: the device
+ *
+ * If no thread can be had, whatever work is queued is done right here, so
+ * that nobody waits for it forever.  The caller holds bdi_list_sem for
+ * reading, or otherwise keeps @bdi from being destroyed.  May sleep.
+ */
+void bdi_start_flusher(struct backing_dev_info *bdi)
+{
+	struct task_struct *task;
+
+	down(&bdi_start_sem);
+	if (bdi->wb_task)
+		goto out;
+
+	task = kthread_run(bdi_writeback_thread, bdi, "flush");
+	if (IS_ERR(task)) {
+		/* It may even free some memory */
+		wb_do_writeback(bdi);
+		goto out;
+	}
+
+	bdi->wb_last_active = jiffies;
+	spin_lock(&bdi->wb_lock);
+	bdi->wb_task = task;
+	spin_unlock(&bdi->wb_lock);
+	spin_lock(&bdi_lock);
+	nr_pdflush_threads++;
+	spin_unlock(&bdi_lock);
+out:
+	up(&bdi_start_sem);
+}
+
+/*
+ * The forker walks the devices whenever it is kicked, and otherwise once per
+ * writeback interval: it starts flushers where there are dirty inodes or
+ * requests, stops those that have been idle too long, and takes over the
+ * writing of dirty superblocks from the old kupdate.
+ */
+static int bdi_forker_thread(void *unused)
+{
+	unsigned long last_sync_supers = jiffies;
+
+	current->flags |= PF_FLUSHER;
+	set_user_nice(current, 0);
+
+	for ( ; ; ) {
+		unsigned long interval = (dirty_writeback_centisecs * HZ) / 100;
+		struct backing_dev_info *bdi;
+
+		down_read(&bdi_list_sem);
+		list_for_each_entry(bdi, &bdi_list, bdi_list) {
+			if (!bdi_cap_writeback_dirty(bdi))
+				continue;
+			if (!bdi->wb_task) {
+				if (bdi_has_dirty_io(bdi) || bdi_has_work(bdi))
+					bdi_start_flusher(bdi);
+			} else if (bdi_has_work(bdi)) {
+				wake_up_process(bdi->wb_task);
+			} else if (!bdi_has_dirty_io(bdi) &&
+				   time_after(jiffies, bdi->wb_last_active +
+							BDI_FLUSHER_IDLE)) {
+				bdi_stop_flusher(bdi, 0);
+			}
+		}
+		up_read(&bdi_list_sem);
+
+		/*将脏的超级块写到磁盘中*/
+		if (interval &&
+		    time_after_eq(jiffies, last_sync_supers + interval)) {
+			last_sync_supers = jiffies;
+			sync_supers();
+		}
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!test_and_clear_bit(0, &bdi_forker_kicked))
+			schedule_timeout(interval ? interval : BDI_FLUSHER_IDLE);
+		__set_current_state(TASK_RUNNING);
+		try_to_freeze();
+	}
+	return 0;
+}
+
+static int __init bdi_forker_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(bdi_forker_thread, NULL, "bdi-default");
+	if (IS_ERR(task)) {
+		printk(KERN_ERR "bdi: could not start the flusher forker\n");
+		return PTR_ERR(task);
+	}
+	bdi_forker_task = task;
+	return 0;
+}
+
+module_init(bdi_forker_init);
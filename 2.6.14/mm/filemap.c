@@ -115,7 +115,7 @@ void __remove_from_page_cache(struct page *page)
 	radix_tree_delete(&mapping->page_tree, page->index);
 	page->mapping = NULL;
 	mapping->nrpages--;
-	pagecache_acct(-1);
+	__dec_zone_page_state(page, NR_FILE_PAGES);
 }
 
 void remove_from_page_cache(struct page *page)
@@ -373,6 +373,48 @@ int filemap_write_and_wait_range(struct address_space *mapping,
 	return retval;
 }
 
+/**
+ * do_sync_mapping_range - write out and/or wait upon a byte range of a mapping
+ * @mapping:	address space structure to operate on
+ * @offset:	first byte of the range
+ * @endbyte:	last byte of the range, inclusive
+ * @flags:	SYNC_FILE_RANGE_WAIT_BEFORE, _WRITE and/or _WAIT_AFTER
+ *
+ * Unlike fsync this touches only the pages of the range, and neither
+ * writes the inode nor flushes the disk cache.  Writeout is started with
+ * WB_SYNC_NONE, so pages that are already under writeback are skipped
+ * rather than waited for; callers wanting integrity pass all three flags.
+ */
+int do_sync_mapping_range(struct address_space *mapping, loff_t offset,
+			  loff_t endbyte, unsigned int flags)
+{
+	int ret = 0;
+
+	if (flags & SYNC_FILE_RANGE_WAIT_BEFORE) {
+		ret = wait_on_page_writeback_range(mapping,
+					offset >> PAGE_CACHE_SHIFT,
+					endbyte >> PAGE_CACHE_SHIFT);
+		if (ret < 0)
+			goto out;
+	}
+
+	if (flags & SYNC_FILE_RANGE_WRITE) {
+		ret = __filemap_fdatawrite_range(mapping, offset, endbyte,
+						 WB_SYNC_NONE);
+		if (ret < 0)
+			goto out;
+	}
+
+	if (flags & SYNC_FILE_RANGE_WAIT_AFTER) {
+		ret = wait_on_page_writeback_range(mapping,
+					offset >> PAGE_CACHE_SHIFT,
+					endbyte >> PAGE_CACHE_SHIFT);
+	}
+out:
+	return ret;
+}
+EXPORT_SYMBOL(do_sync_mapping_range);
+
 /*
  * This function is used to add newly allocated pagecache pages:
  * the page is new, so we can just run SetPageLocked() against it.
@@ -394,7 +436,7 @@ int add_to_page_cache(struct page *page, struct address_space *mapping,
 			page->mapping = mapping;
 			page->index = offset;
 			mapping->nrpages++;
-			pagecache_acct(1);
+			__inc_zone_page_state(page, NR_FILE_PAGES);
 		}
 		write_unlock_irq(&mapping->tree_lock);
 		radix_tree_preload_end();
@@ -502,6 +544,84 @@ void fastcall __lock_page(struct page *page)
 }
 EXPORT_SYMBOL(__lock_page);
 
+/*
+ * Async variant of wait_on_page_bit() for AIO retries.
+ *
+ * When we are running on behalf of a kiocb (current->io_wait points at its
+ * wait entry), don't sleep: hook the kiocb onto the page's wait queue so that
+ * the bit being cleared kicks it via aio_wake_function(), and return
+ * -EIOCBRETRY.  The caller must then back out and let the retry pick up from
+ * where it stopped.  Synchronous callers simply block.
+ */
+int fastcall wait_on_page_bit_async(struct page *page, int bit_nr)
+{
+	wait_queue_t *wait = current->io_wait;
+	wait_queue_head_t *wqh;
+	struct address_space *mapping;
+	unsigned long flags;
+	int queued;
+
+	if (is_sync_wait(wait)) {
+		wait_on_page_bit(page, bit_nr);
+		return 0;
+	}
+
+	if (!test_bit(bit_nr, &page->flags))
+		return 0;
+
+	wqh = page_waitqueue(page);
+	spin_lock_irqsave(&wqh->lock, flags);
+	if (list_empty(&wait->task_list))
+		__add_wait_queue(wqh, wait);
+	spin_unlock_irqrestore(&wqh->lock, flags);
+	set_bit(KIF_WAITING, &io_wait_to_kiocb(wait)->ki_flags);
+
+	/* pairs with the barrier in unlock_page()/end_page_writeback() */
+	smp_mb();
+	if (!test_bit(bit_nr, &page->flags)) {
+		/*
+		 * Lost the race with the waker.  If our entry is still queued
+		 * nobody has kicked us, so take it off again and carry on;
+		 * otherwise the kick is already on its way.
+		 */
+		spin_lock_irqsave(&wqh->lock, flags);
+		queued = !list_empty(&wait->task_list);
+		if (queued)
+			list_del_init(&wait->task_list);
+		spin_unlock_irqrestore(&wqh->lock, flags);
+		if (queued) {
+			clear_bit(KIF_WAITING, &io_wait_to_kiocb(wait)->ki_flags);
+			return 0;
+		}
+		return -EIOCBRETRY;
+	}
+
+	/* get the I/O going, as sync_page() would before sleeping */
+	smp_mb();
+	mapping = page_mapping(page);
+	if (mapping && mapping->a_ops && mapping->a_ops->sync_page)
+		mapping->a_ops->sync_page(page);
+	return -EIOCBRETRY;
+}
+EXPORT_SYMBOL(wait_on_page_bit_async);
+
+/*
+ * Take the page lock, or arrange for the current kiocb to be kicked when it
+ * is released.  Returns 0 with the page locked, or -EIOCBRETRY.
+ */
+int fastcall lock_page_async(struct page *page)
+{
+	int ret;
+
+	while (TestSetPageLocked(page)) {
+		ret = wait_on_page_bit_async(page, PG_locked);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+EXPORT_SYMBOL(lock_page_async);
+
 /*
  * a rather lightweight function, finding and getting a reference to a
  * hashed page atomically.
@@ -736,7 +856,6 @@ void do_generic_mapping_read(struct address_space *mapping,
 	unsigned long end_index;
 	unsigned long offset;
 	unsigned long last_index;
-	unsigned long next_index;
 	unsigned long prev_index;
 	loff_t isize;
 	struct page *cached_page;
@@ -746,7 +865,6 @@ void do_generic_mapping_read(struct address_space *mapping,
 	cached_page = NULL;
 	/*ppos对应的逻辑页索引*/
 	index = *ppos >> PAGE_CACHE_SHIFT;
-	next_index = index;
 	prev_index = ra.prev_page;
 	/*获取本次请求的最后一个字节所在的逻辑页索引*/
 	last_index = (*ppos + desc->count + PAGE_CACHE_SIZE-1) >> PAGE_CACHE_SHIFT;
@@ -778,22 +896,20 @@ void do_generic_mapping_read(struct address_space *mapping,
 		nr = nr - offset;
 
 		cond_resched();
-		/*当内核用用户态请求来读文件数据的页会触发此调用执行预读*/
-		if (index == next_index)
-			next_index = page_cache_readahead(mapping, &ra, filp,
-					index, last_index - index);
-
 find_page:
 		page = find_get_page(mapping, index);
-		if (unlikely(page == NULL)) {
-			/*
-			 * 通过上一步page_cache_readahead，请求页应该已经在page cache
-			 * 如果没有，则说明被回收算法从高速缓存删除
-			 * 因此调整预读系统参数来减少下次预读量
-			 */
-			handle_ra_miss(mapping, &ra, index);
-			goto no_cached_page;
+		if (!page) {
+			/* A miss: read it, and maybe more behind it */
+			page_cache_sync_readahead(mapping, &ra, filp,
+					index, last_index - index);
+			page = find_get_page(mapping, index);
+			if (unlikely(page == NULL))
+				goto no_cached_page;
 		}
+		/* Reader caught up with the readahead marker: keep ahead */
+		if (PageReadahead(page))
+			page_cache_async_readahead(mapping, &ra, filp, page,
+					index, last_index - index);
 		/*如果page已经在page cache中，但不是最新*/
 		if (!PageUptodate(page))
 			goto page_not_up_to_date;
@@ -844,7 +960,9 @@ page_ok:
 page_not_up_to_date:
 		/* Get exclusive access to the page ... */
 		/*尝试锁定页面，如果其它进程正在读取，则会阻塞*/
-		lock_page(page);
+		error = lock_page_async(page);
+		if (unlikely(error))
+			goto readpage_error;
 
 		/* Did it get unhashed before we got the lock? */
 		/*为防止在持有锁后有进程将页面释放，检查page->mapping*/
@@ -876,8 +994,12 @@ readpage:
 			/*
 			 * 此处锁住页面，由于前面在find page时已经持有锁，因此此处会被阻塞
 			 * 直到bio->end_io回调将页面标记为最新才会解锁
+			 * AIO retries don't sleep here: they get -EIOCBRETRY
+			 * and pick up again at *ppos once the page is unlocked.
 			 */
-			lock_page(page);
+			error = lock_page_async(page);
+			if (unlikely(error))
+				goto readpage_error;
 			if (!PageUptodate(page)) {
 				if (page->mapping == NULL) {
 					/*
@@ -928,7 +1050,10 @@ readpage:
 		goto page_ok;
 
 readpage_error:
-		/* UHHUH! A synchronous read error occurred. Report it */
+		/*
+		 * UHHUH! A synchronous read error occurred. Report it
+		 * (or -EIOCBRETRY: an AIO retry will continue from here).
+		 */
 		desc->error = error;
 		page_cache_release(page);
 		goto out;
@@ -962,6 +1087,7 @@ no_cached_page:
 
 out:
 	/*所有请求的或可以读取到的数据已读完，更新预读数据*/
+	ra.prev_page = prev_index;
 	*_ra = ra;
 	
 	/*把index*4096+offset赋值给ppos,供以后read/write调用*/
@@ -1119,6 +1245,16 @@ generic_file_aio_read(struct kiocb *iocb, char __user *buf, size_t count, loff_t
 }
 
 EXPORT_SYMBOL(generic_file_aio_read);
+
+ssize_t
+generic_file_aio_readv(struct kiocb *iocb, const struct iovec *iov,
+			unsigned long nr_segs, loff_t pos)
+{
+	BUG_ON(iocb->ki_pos != pos);
+	return __generic_file_aio_read(iocb, iov, nr_segs, &iocb->ki_pos);
+}
+
+EXPORT_SYMBOL(generic_file_aio_readv);
 /*
  * @ppos:一般为filp->f_pos
  * 实现了普通文件和块文件的通用read方法
@@ -1248,6 +1384,20 @@ static int fastcall page_cache_read(struct file * file, unsigned long offset)
 
 #define MMAP_LOTSAMISS  (100)
 
+/*
+ * The page we need is locked for I/O.  Wait for it without holding
+ * mmap_sem, so that the rest of the address space isn't stalled behind the
+ * disk, and have the fault retried.  @area may be gone once we return.
+ */
+static struct page *nopage_wait_and_retry(struct vm_area_struct *area,
+					  struct page *page)
+{
+	up_read(&area->vm_mm->mmap_sem);
+	wait_on_page_locked(page);
+	page_cache_release(page);
+	return NOPAGE_RETRY;
+}
+
 /*
  * filemap_nopage() is invoked via the vma operations vector for a
  * mapped memory region to read in file data during a page fault.
@@ -1274,6 +1424,7 @@ struct page *filemap_nopage(struct vm_area_struct *area,
 	struct page *page;
 	unsigned long size, pgoff;
 	int did_readaround = 0, majmin = VM_FAULT_MINOR;
+	int allow_retry = type && *type == VM_FAULT_RETRY;
 
 	/*pgoff存放address开始的页对应的数据在文件中的偏移量*/
 	pgoff = ((address-area->vm_start) >> PAGE_CACHE_SHIFT) + area->vm_pgoff;
@@ -1289,30 +1440,29 @@ retry_all:
 	if (VM_RandomReadHint(area))
 		goto no_cached_page;
 
-	/*
-	 * The readahead code wants to be told about each and every page
-	 * so it can build and shrink its windows appropriately
-	 *
-	 * For sequential accesses, we use the generic readahead logic.
-	 */
-	/*如果线性区VMA的VM_SEQ_READ置位，假定进程以严格顺序方式读内存映射中的页*/
-	if (VM_SequentialReadHint(area))
-		/*从缺页处pgoff开始预读*/
-		page_cache_readahead(mapping, ra, file, pgoff, 1);
-
 	/*
 	 * Do we have something in the page cache already?
 	 */
 retry_find:
 	page = find_get_page(mapping, pgoff);
+	/*
+	 * For sequential accesses, we use the generic readahead logic.
+	 */
+	/*如果线性区VMA的VM_SEQ_READ置位，假定进程以严格顺序方式读内存映射中的页*/
+	if (VM_SequentialReadHint(area)) {
+		if (!page) {
+			page_cache_sync_readahead(mapping, ra, file, pgoff, 1);
+			page = find_get_page(mapping, pgoff);
+			if (!page)
+				goto no_cached_page;
+		}
+		if (PageReadahead(page))
+			page_cache_async_readahead(mapping, ra, file, page,
+						   pgoff, 1);
+	}
 	if (!page) {
 		unsigned long ra_pages;
 		
-		/*预读算法失败，需要调整预读参数*/
-		if (VM_SequentialReadHint(area)) {
-			handle_ra_miss(mapping, ra, pgoff);
-			goto no_cached_page;
-		}
 		ra->mmap_miss++;
 
 		/*
@@ -1408,7 +1558,11 @@ page_not_uptodate:
 		inc_page_state(pgmajfault);
 	}
 	/*页面不是最新则锁定页面*/
-	lock_page(page);
+	if (TestSetPageLocked(page)) {
+		if (allow_retry)
+			return nopage_wait_and_retry(area, page);
+		lock_page(page);
+	}
 
 	/* Did it get unhashed while we waited for it? */
 	if (!page->mapping) {
@@ -1425,6 +1579,8 @@ page_not_uptodate:
 	
 	/*执行readpage回调从磁盘读取页面，然后等待页面解锁即是最新页面*/
 	if (!mapping->a_ops->readpage(file, page)) {
+		if (allow_retry && PageLocked(page))
+			return nopage_wait_and_retry(area, page);
 		wait_on_page_locked(page);
 		if (PageUptodate(page))
 			goto success;
@@ -1640,9 +1796,56 @@ repeat:
 }
 EXPORT_SYMBOL(filemap_populate);
 
+/*
+ * ->map_pages() for fault-around: map the pages of [start_pgoff, end_pgoff]
+ * that are cached, uptodate and not locked by anybody else.  Runs under the
+ * pte lock, so nothing here may sleep; pages that aren't ready are left to
+ * ->nopage() when they are actually touched.
+ */
+void filemap_map_pages(struct vm_area_struct *vma, unsigned long address,
+		pte_t *pte, pgoff_t start_pgoff, pgoff_t end_pgoff)
+{
+	struct address_space *mapping = vma->vm_file->f_mapping;
+	struct inode *inode = mapping->host;
+	unsigned long size;
+	struct page *page;
+	pgoff_t pgoff;
+
+	for (pgoff = start_pgoff; pgoff <= end_pgoff;
+	     pgoff++, pte++, address += PAGE_SIZE) {
+		if (!pte_none(*pte))
+			continue;
+		page = find_get_page(mapping, pgoff);
+		if (!page)
+			continue;
+		/* Leave readahead markers for a real fault to trigger */
+		if (!PageUptodate(page) || PageReadahead(page))
+			goto skip;
+		if (TestSetPageLocked(page))
+			goto skip;
+		/* Truncated, or invalidated, under us? */
+		if (page->mapping != mapping || !PageUptodate(page))
+			goto unlock;
+		size = (i_size_read(inode) + PAGE_CACHE_SIZE - 1) >>
+							PAGE_CACHE_SHIFT;
+		if (page->index >= size)
+			goto unlock;
+
+		do_set_pte(vma, address, page, pte, 0, 0);
+		unlock_page(page);
+		continue;
+unlock:
+		unlock_page(page);
+skip:
+		page_cache_release(page);
+	}
+}
+EXPORT_SYMBOL(filemap_map_pages);
+
 struct vm_operations_struct generic_file_vm_ops = {
 	.nopage		= filemap_nopage,
 	.populate	= filemap_populate,
+	.map_pages	= filemap_map_pages,
 };
 
 /* This is used for a general mmap of a disk file */
@@ -1979,6 +2182,128 @@ generic_file_direct_write(struct kiocb *iocb, const struct iovec *iov,
 	return written;
 }
 EXPORT_SYMBOL(generic_file_direct_write);
+/*
+ * Most pages a write spans at once through ->prepare_write_pages.
+ */
+#define WRITE_BATCH_PAGES	16
+
+/*
+ * Write @bytes at @pos from a single user buffer through the multi-page
+ * a_ops: grab and lock all the pages first, have the filesystem prepare and
+ * commit the whole range with one call each, and account the dirtying once.
+ *
+ * With several page locks held we must not fault on the user buffer: it may
+ * be mapped from these very pages.  So it is faulted in beforehand and the
+ * copy is only tried atomically.  If that still comes up short, the copy
+ * stops there and only what was copied is committed; the short count is
+ * returned for the caller to redo the remainder a page at a time, where
+ * the copy may sleep and a real fault ends in -EFAULT.
+ *
+ * Returns the number of bytes written, or a negative error.
+ */
+static ssize_t
+generic_file_write_pages(struct file *file, loff_t pos,
+		const char __user *buf, size_t bytes,
+		struct page **cached_page, struct pagevec *lru_pvec)
+{
+	struct address_space *mapping = file->f_mapping;
+	struct address_space_operations *a_ops = mapping->a_ops;
+	struct inode *inode = mapping->host;
+	struct page *pages[WRITE_BATCH_PAGES];
+	unsigned long index = pos >> PAGE_CACHE_SHIFT;
+	unsigned from = pos & (PAGE_CACHE_SIZE - 1);
+	unsigned to, nr, i;
+	size_t copied = 0, off;
+	ssize_t status;
+
+	for (off = 0; off < bytes; off += PAGE_SIZE)
+		fault_in_pages_readable(buf + off,
+				min_t(size_t, bytes - off, PAGE_SIZE));
+
+	nr = (from + bytes + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	BUG_ON(nr > WRITE_BATCH_PAGES);
+	to = from + bytes - ((nr - 1) << PAGE_CACHE_SHIFT);
+	for (i = 0; i < nr; i++) {
+		pages[i] = __grab_cache_page(mapping, index + i,
+					     cached_page, lru_pvec);
+		if (!pages[i]) {
+			if (!i)
+				return -ENOMEM;
+			nr = i;
+			to = PAGE_CACHE_SIZE;
+			break;
+		}
+	}
+
+	status = a_ops->prepare_write_pages(file, pages, nr, from, to);
+	if (unlikely(status < 0)) {
+		loff_t isize = i_size_read(inode);
+
+		for (i = 0; i < nr; i++) {
+			unlock_page(pages[i]);
+			page_cache_release(pages[i]);
+		}
+		/*
+		 * prepare_write_pages() may have instantiated a few blocks
+		 * outside i_size.  Trim these off again.
+		 */
+		if (pos + bytes > isize)
+			vmtruncate(inode, isize);
+		return status;
+	}
+	if (unlikely(status < nr)) {
+		/* The pages it could not prepare go back untouched */
+		for (i = status; i < nr; i++) {
+			unlock_page(pages[i]);
+			page_cache_release(pages[i]);
+		}
+		nr = status;
+		to = PAGE_CACHE_SIZE;
+	}
+
+	for (i = 0; i < nr; i++) {
+		unsigned offset = i ? 0 : from;
+		unsigned len = (i == nr - 1 ? to : PAGE_CACHE_SIZE) - offset;
+		unsigned left;
+		char *kaddr;
+
+		kaddr = kmap_atomic(pages[i], KM_USER0);
+		left = __copy_from_user_inatomic(kaddr + offset,
+						 buf + copied, len);
+		kunmap_atomic(kaddr, KM_USER0);
+		flush_dcache_page(pages[i]);
+		copied += len - left;
+		if (unlikely(left))
+			break;
+	}
+
+	/* Called on every prepared page, so it can clean up the rest */
+	status = a_ops->commit_write_pages(file, pages, nr, from, to, copied);
+	for (i = 0; i < nr; i++) {
+		unlock_page(pages[i]);
+		mark_page_accessed(pages[i]);
+		page_cache_release(pages[i]);
+	}
+
+	/*
+	 * Blocks may have been instantiated past what was committed: for a
+	 * page that could not be prepared, or one the copy did not reach.
+	 */
+	if (unlikely(status < 0 ||
+		     status < ((nr - 1) << PAGE_CACHE_SHIFT) + to - from)) {
+		loff_t isize = i_size_read(inode);
+
+		if (pos + bytes > isize)
+			vmtruncate(inode, isize);
+	}
+	if (status <= 0)
+		return status;
+
+	balance_dirty_pages_ratelimited_nr(mapping,
+			(from + status + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT);
+	return status;
+}
+
 /*
  * @iocb: 用于跟踪当前正在进行的IO操作
  * @pos: 经过调整后的写入位置
@@ -2003,9 +2328,17 @@ generic_file_buffered_write(struct kiocb *iocb, const struct iovec *iov,
 	const struct iovec *cur_iov = iov; /* current iovec */
 	size_t		iov_base = 0;	   /* offset in the current iovec */
 	char __user	*buf;
+	int		batch;
 
 	pagevec_init(&lru_pvec, 0);
 
+	/*
+	 * Writes from a single buffer go through the multi-page a_ops when
+	 * the filesystem has them, several pages at a time.
+	 */
+	batch = nr_segs == 1 && a_ops->prepare_write_pages &&
+		a_ops->commit_write_pages;
+
 	/*
 	 * handle partial DIO write.  Adjust cur_iov if needed.
 	 */
@@ -2031,6 +2364,26 @@ generic_file_buffered_write(struct kiocb *iocb, const struct iovec *iov,
 		if (bytes > count)
 			bytes = count;
 
+		if (batch > 0 && count > bytes) {
+			bytes = (WRITE_BATCH_PAGES << PAGE_CACHE_SHIFT) - offset;
+			if (bytes > count)
+				bytes = count;
+			status = generic_file_write_pages(file, pos, buf, bytes,
+						&cached_page, &lru_pvec);
+			if (status < 0)
+				break;
+			written += status;
+			count -= status;
+			pos += status;
+			buf += status;
+			iov_base += status;
+			/* Came up short: do the next page the slow way */
+			if ((size_t)status < bytes)
+				batch = -1;
+			cond_resched();
+			continue;
+		}
+
 		/*
 		 * Bring in the user page that we will copy from _first_.
 		 * Otherwise there's a nasty deadlock on copying from the
@@ -2107,6 +2460,8 @@ generic_file_buffered_write(struct kiocb *iocb, const struct iovec *iov,
 			break;
 		/*检查page/buffer cache中脏页比例是否超过一个固定的阀值（通常为系统页40%）,如果是就刷新页到磁盘*/
 		balance_dirty_pages_ratelimited(mapping);
+		if (batch < 0)
+			batch = 1;
 		cond_resched();
 	} while (count);
 	/*写操作文件的所有页都已经处理，更新ppos让它指向文件的最后一个字符*/
@@ -2139,6 +2494,85 @@ generic_file_buffered_write(struct kiocb *iocb, const struct iovec *iov,
 	return written ? written : status;
 }
 EXPORT_SYMBOL(generic_file_buffered_write);
+
+/*
+ * Copy @bytes from the kernel page @src, starting at @src_offset, into the
+ * page cache of @file at *@ppos through ->prepare_write/->commit_write.
+ * This is the write half of splice and of in-kernel file copies, where the
+ * source data already sits in a page and never goes near user space.
+ *
+ * The caller holds i_sem for regular files and has done the write checks.
+ * Returns the number of bytes copied (*@ppos is advanced by that much) or a
+ * negative errno if nothing could be copied.
+ */
+ssize_t generic_file_write_page(struct file *file, struct page *src,
+		unsigned long src_offset, size_t bytes, loff_t *ppos)
+{
+	struct address_space *mapping = file->f_mapping;
+	struct address_space_operations *a_ops = mapping->a_ops;
+	struct inode *inode = mapping->host;
+	struct page *cached_page = NULL;
+	struct pagevec lru_pvec;
+	loff_t pos = *ppos;
+	ssize_t written = 0;
+	long status = 0;
+
+	pagevec_init(&lru_pvec, 0);
+
+	while (bytes) {
+		unsigned long index = pos >> PAGE_CACHE_SHIFT;
+		unsigned long offset = pos & (PAGE_CACHE_SIZE - 1);
+		unsigned long count = min_t(size_t, PAGE_CACHE_SIZE - offset,
+					    bytes);
+		struct page *page;
+		char *from, *to;
+
+		page = __grab_cache_page(mapping, index, &cached_page,
+					 &lru_pvec);
+		if (!page) {
+			status = -ENOMEM;
+			break;
+		}
+		status = a_ops->prepare_write(file, page, offset,
+					      offset + count);
+		if (unlikely(status)) {
+			loff_t isize = i_size_read(inode);
+
+			unlock_page(page);
+			page_cache_release(page);
+			if (pos + count > isize)
+				vmtruncate(inode, isize);
+			break;
+		}
+		from = kmap_atomic(src, KM_USER0);
+		to = kmap_atomic(page, KM_USER1);
+		memcpy(to + offset, from + src_offset, count);
+		kunmap_atomic(to, KM_USER1);
+		kunmap_atomic(from, KM_USER0);
+		flush_dcache_page(page);
+		status = a_ops->commit_write(file, page, offset,
+					     offset + count);
+		unlock_page(page);
+		mark_page_accessed(page);
+		page_cache_release(page);
+		if (status < 0)
+			break;
+
+		written += count;
+		pos += count;
+		src_offset += count;
+		bytes -= count;
+		balance_dirty_pages_ratelimited(mapping);
+		cond_resched();
+	}
+	*ppos = pos;
+
+	if (cached_page)
+		page_cache_release(cached_page);
+	pagevec_lru_add(&lru_pvec);
+	return written ? written : status;
+}
+EXPORT_SYMBOL(generic_file_write_page);
 /*
  * @iov: 
  * @nr_segs:iov数组的长度,generic_file_write只有一个元素
@@ -2284,20 +2718,18 @@ generic_file_write_nolock(struct file *file, const struct iovec *iov,
 }
 EXPORT_SYMBOL(generic_file_write_nolock);
 
-ssize_t generic_file_aio_write(struct kiocb *iocb, const char __user *buf,
-			       size_t count, loff_t pos)
+ssize_t generic_file_aio_writev(struct kiocb *iocb, const struct iovec *iov,
+				unsigned long nr_segs, loff_t pos)
 {
 	struct file *file = iocb->ki_filp;
 	struct address_space *mapping = file->f_mapping;
 	struct inode *inode = mapping->host;
 	ssize_t ret;
-	struct iovec local_iov = { .iov_base = (void __user *)buf,
-					.iov_len = count };
 
 	BUG_ON(iocb->ki_pos != pos);
 
 	down(&inode->i_sem);
-	ret = __generic_file_aio_write_nolock(iocb, &local_iov, 1,
+	ret = __generic_file_aio_write_nolock(iocb, iov, nr_segs,
 						&iocb->ki_pos);
 	up(&inode->i_sem);
 
@@ -2310,6 +2742,16 @@ ssize_t generic_file_aio_write(struct kiocb *iocb, const char __user *buf,
 	}
 	return ret;
 }
+EXPORT_SYMBOL(generic_file_aio_writev);
+
+ssize_t generic_file_aio_write(struct kiocb *iocb, const char __user *buf,
+			       size_t count, loff_t pos)
+{
+	struct iovec local_iov = { .iov_base = (void __user *)buf,
+					.iov_len = count };
+
+	return generic_file_aio_writev(iocb, &local_iov, 1, pos);
+}
 EXPORT_SYMBOL(generic_file_aio_write);
 
 /*通用的文件写函数*/
@@ -126,8 +126,8 @@ static void free_pte_range(struct mmu_gather *tlb, pmd_t *pmd)
 	struct page *page = pmd_page(*pmd);
 	pmd_clear(pmd);
 	pte_lock_deinit(page);
+	dec_zone_page_state(page, NR_PAGETABLE);
 	pte_free_tlb(tlb, page);
-	dec_page_state(nr_page_table_pages);
 	tlb->mm->nr_ptes--;
 }
 
@@ -313,7 +313,7 @@ int __pte_alloc(struct mm_struct *mm, pmd_t *pmd, unsigned long address)
 		pte_free(new);
 	} else {
 		mm->nr_ptes++;
-		inc_page_state(nr_page_table_pages);
+		inc_zone_page_state(new, NR_PAGETABLE);
 		pmd_populate(mm, pmd, new);
 	}
 	spin_unlock(&mm->page_table_lock);
@@ -1039,6 +1039,27 @@ int get_user_pages(struct task_struct *tsk, struct mm_struct *mm,
 }
 EXPORT_SYMBOL(get_user_pages);
 
+#ifndef __HAVE_ARCH_GET_USER_PAGES_FAST
+/*
+ * Architectures which can walk their page tables without mmap_sem
+ * provide their own lockless version; everyone else just takes
+ * mmap_sem around the regular get_user_pages().
+ */
+int get_user_pages_fast(unsigned long start, int nr_pages, int write,
+			struct page **pages)
+{
+	struct mm_struct *mm = current->mm;
+	int ret;
+
+	down_read(&mm->mmap_sem);
+	ret = get_user_pages(current, mm, start, nr_pages, write, 0,
+			     pages, NULL);
+	up_read(&mm->mmap_sem);
+
+	return ret;
+}
+#endif
+
 static int zeromap_pte_range(struct mm_struct *mm, pmd_t *pmd,
 			unsigned long addr, unsigned long end, pgprot_t prot)
 {
@@ -1285,7 +1306,8 @@ static int do_wp_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	struct page *old_page, *new_page;
 	unsigned long pfn = pte_pfn(orig_pte);
 	pte_t entry;
-	int ret = VM_FAULT_MINOR;
+	int reuse = 0, ret = VM_FAULT_MINOR;
+	struct page *dirty_page = NULL;
 
 	BUG_ON(vma->vm_flags & VM_RESERVED);
 
@@ -1300,18 +1322,50 @@ static int do_wp_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	old_page = pfn_to_page(pfn);
 
 	if (PageAnon(old_page) && !TestSetPageLocked(old_page)) {
-		int reuse = can_share_swap_page(old_page);
+		reuse = can_share_swap_page(old_page);
 		unlock_page(old_page);
-		if (reuse) {
-			flush_cache_page(vma, address, pfn);
-			entry = pte_mkyoung(orig_pte);
-			entry = maybe_mkwrite(pte_mkdirty(entry), vma);
-			ptep_set_access_flags(vma, address, page_table, entry, 1);
-			update_mmu_cache(vma, address, entry);
-			lazy_mmu_prot_update(entry);
-			ret |= VM_FAULT_WRITE;
-			goto unlock;
+	} else if (unlikely((vma->vm_flags & (VM_WRITE|VM_SHARED)) ==
+					(VM_WRITE|VM_SHARED))) {
+		/*
+		 * Clean pages of a shared writable mapping are mapped
+		 * read-only (see vma_wants_writenotify), so that the first
+		 * write lands here: tell the filesystem, then make the pte
+		 * writable and dirty the page.
+		 */
+		struct address_space *mapping = vma->vm_file->f_mapping;
+
+		if (mapping->a_ops->page_mkwrite) {
+			/*
+			 * ->page_mkwrite may sleep, so drop the pte lock and
+			 * recheck the pte afterwards.
+			 */
+			page_cache_get(old_page);
+			pte_unmap_unlock(page_table, ptl);
+
+			if (mapping->a_ops->page_mkwrite(vma->vm_file,
+							 old_page) < 0)
+				goto unwritable_page;
+
+			page_table = pte_offset_map_lock(mm, pmd, address,
+							 &ptl);
+			page_cache_release(old_page);
+			if (!pte_same(*page_table, orig_pte))
+				goto unlock;
 		}
+		dirty_page = old_page;
+		get_page(dirty_page);
+		reuse = 1;
+	}
+
+	if (reuse) {
+		flush_cache_page(vma, address, pfn);
+		entry = pte_mkyoung(orig_pte);
+		entry = maybe_mkwrite(pte_mkdirty(entry), vma);
+		ptep_set_access_flags(vma, address, page_table, entry, 1);
+		update_mmu_cache(vma, address, entry);
+		lazy_mmu_prot_update(entry);
+		ret |= VM_FAULT_WRITE;
+		goto unlock;
 	}
 
 	/*
@@ -1368,10 +1422,18 @@ static int do_wp_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	page_cache_release(old_page);
 unlock:
 	pte_unmap_unlock(page_table, ptl);
+	if (dirty_page) {
+		set_page_dirty_balance(dirty_page);
+		put_page(dirty_page);
+	}
 	return ret;
 oom:
 	page_cache_release(old_page);
 	return VM_FAULT_OOM;
+
+unwritable_page:
+	page_cache_release(old_page);
+	return VM_FAULT_SIGBUS;
 }
 
 /*
@@ -1896,6 +1958,87 @@ oom:
 	return VM_FAULT_OOM;
 }
 
+/*
+ * Install a pte for @page at @address.  The caller holds the pte lock and
+ * has checked that the pte is still none; the page reference it holds
+ * becomes the mapping's.
+ */
+void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		struct page *page, pte_t *pte, int write, int anon)
+{
+	pte_t entry;
+
+	flush_icache_page(vma, page);
+	/*用新页框的地址以及线性区的vm_page_prot字段包含的页访问权设置缺页所在的地址对应的页表项*/
+	entry = mk_pte(page, vma->vm_page_prot);
+	/*如果进程试图对这个页想入，则把页表项的Read/Write/Dirty位强制设为1*/
+	if (write)
+		entry = maybe_mkwrite(pte_mkdirty(entry), vma);
+	/*设置pte项到页表*/
+	set_pte_at(vma->vm_mm, address, pte, entry);
+	if (anon) {
+		inc_mm_counter(vma->vm_mm, anon_rss);
+		lru_cache_add_active(page);
+		page_add_anon_rmap(page, vma, address);
+	} else if (!(vma->vm_flags & VM_RESERVED)) {
+		/*增加进程内存描述符的rss字段，表示一个新页框已经分配给进程*/
+		inc_mm_counter(vma->vm_mm, file_rss);
+		page_add_file_rmap(page);
+	}
+
+	/* no need to invalidate: a not-present page shouldn't be cached */
+	update_mmu_cache(vma, address, entry);
+	lazy_mmu_prot_update(entry);
+}
+
+/*
+ * Number of pages around a read fault that ->map_pages() may map along
+ * with the faulting one.  Rounded down to a power of two; 0 or 1 turns
+ * fault-around off.
+ */
+int fault_around_pages = 16;
+
+static int __init set_fault_around_pages(char *str)
+{
+	if (!str)
+		return 0;
+	fault_around_pages = simple_strtoul(str, &str, 0);
+	return 1;
+}
+__setup("fault_around_pages=", set_fault_around_pages);
+
+/*
+ * Map whatever is already cached around @address, which has its pte mapped
+ * at @pte and locked: the naturally aligned fault_around_pages window that
+ * contains it, clipped to the vma and to this page table.
+ */
+static void do_fault_around(struct vm_area_struct *vma, unsigned long address,
+		pte_t *pte, pgoff_t pgoff)
+{
+	unsigned long start_addr, nr_pages, off;
+	pgoff_t end_pgoff;
+
+	nr_pages = min_t(unsigned long, fault_around_pages, PTRS_PER_PTE);
+	if (nr_pages & (nr_pages - 1))
+		nr_pages = roundup_pow_of_two(nr_pages) >> 1;
+
+	start_addr = max(address & ~((nr_pages << PAGE_SHIFT) - 1),
+			 vma->vm_start);
+	off = (address - start_addr) >> PAGE_SHIFT;
+	pte -= off;
+	pgoff -= off;
+
+	/*
+	 * The window is aligned to its own size, which is at most a page
+	 * table's worth, so it never crosses into the next page table.
+	 */
+	end_pgoff = pgoff + nr_pages - 1 -
+		((start_addr >> PAGE_SHIFT) & (nr_pages - 1));
+	end_pgoff = min(end_pgoff, vma->vm_pgoff + vma_pages(vma) - 1);
+
+	vma->vm_ops->map_pages(vma, start_addr, pte, pgoff, end_pgoff);
+}
+
 /*
  * do_no_page() tries to create a new page mapping. It aggressively
  * tries to share with existing pages, but makes a separate copy if
@@ -1919,15 +2062,15 @@ oom:
  */
 static int do_no_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		unsigned long address, pte_t *page_table, pmd_t *pmd,
-		int write_access)
+		int write_access, int flags)
 {
 	spinlock_t *ptl;
 	struct page *new_page;
 	struct address_space *mapping = NULL;
-	pte_t entry;
 	unsigned int sequence = 0;
 	int ret = VM_FAULT_MINOR;
 	int anon = 0;
+	struct page *dirty_page = NULL;
 
 	pte_unmap(page_table);
 
@@ -1936,7 +2079,28 @@ static int do_no_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		sequence = mapping->truncate_count;
 		smp_rmb(); /* serializes i_size against truncate_count */
 	}
+
+	/*
+	 * On a read fault, map the neighbouring pages that are already
+	 * cached too, under one pte lock.  If that covered the faulting
+	 * address, there is nothing left to do.
+	 */
+	if (!write_access && vma->vm_ops->map_pages &&
+	    fault_around_pages > 1 && !(vma->vm_flags & VM_NONLINEAR)) {
+		pgoff_t pgoff = ((address - vma->vm_start) >> PAGE_SHIFT) +
+				vma->vm_pgoff;
+
+		page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
+		do_fault_around(vma, address, page_table, pgoff);
+		if (!pte_none(*page_table)) {
+			pte_unmap_unlock(page_table, ptl);
+			return VM_FAULT_MINOR;
+		}
+		pte_unmap_unlock(page_table, ptl);
+	}
 retry:
+	if (flags & FAULT_FLAG_ALLOW_RETRY)
+		ret = VM_FAULT_RETRY;
 	/*调用nopage方法(一般为filemap_nopage)，返回包含所请求页的页框的地址*/
 	new_page = vma->vm_ops->nopage(vma, address & PAGE_MASK, &ret);
 	/*
@@ -1952,6 +2116,14 @@ retry:
 		return VM_FAULT_SIGBUS;
 	if (new_page == NOPAGE_OOM)
 		return VM_FAULT_OOM;
+	/* mmap_sem is gone, and with it our right to touch vma */
+	if (new_page == NOPAGE_RETRY)
+		return VM_FAULT_RETRY;
+	/* ->nopage() that doesn't know about retries left *type alone */
+	if (ret == VM_FAULT_RETRY)
+		ret = VM_FAULT_MINOR;
+	/* Only the first attempt may be retried */
+	flags &= ~FAULT_FLAG_ALLOW_RETRY;
 
 	/*
 	 * Should we do an early C-O-W break?
@@ -1971,6 +2143,16 @@ retry:
 		page_cache_release(new_page);
 		new_page = page;
 		anon = 1;
+	} else if (write_access && mapping && mapping->a_ops->page_mkwrite) {
+		/*
+		 * Writing into a shared mapping: let the filesystem prepare
+		 * the page (allocate blocks, reserve space) before it can
+		 * be dirtied through the pte.
+		 */
+		if (mapping->a_ops->page_mkwrite(vma->vm_file, new_page) < 0) {
+			page_cache_release(new_page);
+			return VM_FAULT_SIGBUS;
+		}
 	}
 	/*获取对应的pte项*/
 	page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
@@ -2001,34 +2183,22 @@ retry:
 	 */
 	/* Only go through if we didn't race with anybody else... */
 	if (pte_none(*page_table)) {
-		flush_icache_page(vma, new_page);
-		/*用新页框的地址以及线性区的vm_page_prot字段包含的页访问权设置缺页所在的地址对应的页表项*/
-		entry = mk_pte(new_page, vma->vm_page_prot);
-		/*如果进程试图对这个页想入，则把页表项的Read/Write/Dirty位强制设为1*/
-		if (write_access)
-			entry = maybe_mkwrite(pte_mkdirty(entry), vma);
-		/*设置pte项到页表*/
-		set_pte_at(mm, address, page_table, entry);
-		if (anon) {
-			inc_mm_counter(mm, anon_rss);
-			lru_cache_add_active(new_page);
-			page_add_anon_rmap(new_page, vma, address);
-		} else if (!(vma->vm_flags & VM_RESERVED)) {
-			/*增加进程内存描述符的rss字段，表示一个新页框已经分配给进程*/
-			inc_mm_counter(mm, file_rss);
-			page_add_file_rmap(new_page);
+		do_set_pte(vma, address, new_page, page_table,
+			   write_access, anon);
+		if (write_access && !anon &&
+		    !(vma->vm_flags & VM_RESERVED)) {
+			dirty_page = new_page;
+			get_page(dirty_page);
 		}
 	} else {
 		/* One of our sibling threads was faster, back out. */
 		page_cache_release(new_page);
-		goto unlock;
 	}
-
-	/* no need to invalidate: a not-present page shouldn't be cached */
-	update_mmu_cache(vma, address, entry);
-	lazy_mmu_prot_update(entry);
-unlock:
 	pte_unmap_unlock(page_table, ptl);
+	if (dirty_page) {
+		set_page_dirty_balance(dirty_page);
+		put_page(dirty_page);
+	}
 	return ret;
 oom:
 	page_cache_release(new_page);
@@ -2088,7 +2258,7 @@ static int do_file_page(struct mm_struct *mm, struct vm_area_struct *vma,
  */
 static inline int handle_pte_fault(struct mm_struct *mm,
 		struct vm_area_struct *vma, unsigned long address,
-		pte_t *pte, pmd_t *pmd, int write_access)
+		pte_t *pte, pmd_t *pmd, int write_access, int flags)
 {
 	pte_t entry;
 	pte_t old_entry;
@@ -2106,7 +2276,7 @@ static inline int handle_pte_fault(struct mm_struct *mm,
 					pte, pmd, write_access);
 			/*页映射到一个磁盘文件，则vma->vm_ops->nopage非空*/
 			return do_no_page(mm, vma, address,
-					pte, pmd, write_access);
+					pte, pmd, write_access, flags);
 		}
 		/*情形2：页表项p位为0，D位为1，页属于非线性磁盘映射*/
 		if (pte_file(entry))
@@ -2162,15 +2332,19 @@ unlock:
  * @vma: 引起异常的线性地址所在线性区的描述符
  * @address: 引起异常的线性地址
  * @write_access: 如果task试图向address写，则置为1，如果task试图在address读或执行，则置为0 
+ *                FAULT_FLAG_ALLOW_RETRY may be or'ed in, see handle_mm_fault()
  */
 int __handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 		unsigned long address, int write_access)
 {
+	int flags = write_access;
 	pgd_t *pgd;
 	pud_t *pud;
 	pmd_t *pmd;
 	pte_t *pte;
 
+	write_access &= FAULT_FLAG_WRITE;
+
 	__set_current_state(TASK_RUNNING);
 
 	inc_page_state(pgfault);
@@ -2196,7 +2370,7 @@ int __handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	 * 检查address地址所对应的页表项pte，
 	 * 根据pte位决定通过请求调页（访问的页不存在）或写时复制（访问的页标记为只读）分配一个新的页框
 	 */
-	return handle_pte_fault(mm, vma, address, pte, pmd, write_access);
+	return handle_pte_fault(mm, vma, address, pte, pmd, write_access, flags);
 }
 
 #ifndef __PAGETABLE_PUD_FOLDED
@@ -24,6 +24,7 @@
 #include <linux/mount.h>
 #include <linux/mempolicy.h>
 #include <linux/rmap.h>
+#include <linux/backing-dev.h>
 
 #include <asm/uaccess.h>
 #include <asm/cacheflush.h>
@@ -885,6 +886,39 @@ void vm_stat_account(struct mm_struct *mm, unsigned long flags,
 }
 #endif /* CONFIG_PROC_FS */
 
+/*
+ * Some shared mappings will want the pages marked read-only to track write
+ * events: the first write to a clean page then faults, so that the page
+ * is dirtied, the writer throttled and ->page_mkwrite called.  This
+ * returns true if @vma is one of them.
+ */
+int vma_wants_writenotify(struct vm_area_struct *vma)
+{
+	unsigned int vm_flags = vma->vm_flags;
+
+	/* If it was private or non-writable, the write bit is already clear */
+	if ((vm_flags & (VM_WRITE|VM_SHARED)) != (VM_WRITE|VM_SHARED))
+		return 0;
+
+	/* The backer wishes to know when pages are first written to? */
+	if (vma->vm_file && vma->vm_file->f_mapping->a_ops->page_mkwrite)
+		return 1;
+
+	/* The open routine did something to the protections already? */
+	if (pgprot_val(vma->vm_page_prot) !=
+	    pgprot_val(protection_map[vm_flags & 0x0f]))
+		return 0;
+
+	/* Specialty mapping? */
+	if (vm_flags & (VM_RESERVED|VM_IO|VM_NONLINEAR))
+		return 0;
+
+	/* Can the mapping track the dirty pages? */
+	return vma->vm_file &&
+		mapping_cap_account_dirty(vma->vm_file->f_mapping);
+}
+EXPORT_SYMBOL(vma_wants_writenotify);
+
 /*
  * The caller must hold down_write(current->mm->mmap_sem).
  */
@@ -1135,6 +1169,13 @@ munmap_back:
 		error = file->f_op->mmap(file, vma);
 		if (error)
 			goto unmap_and_free_vma;
+		/*
+		 * Map clean pages read-only, so that the first write to each
+		 * is seen by the dirty accounting.
+		 */
+		if (vma_wants_writenotify(vma))
+			vma->vm_page_prot = protection_map[vma->vm_flags &
+					(VM_READ|VM_WRITE|VM_EXEC)];
 		if ((vma->vm_flags & (VM_SHARED | VM_WRITE | VM_RESERVED))
 						== (VM_WRITE | VM_RESERVED)) {
 			printk(KERN_WARNING "program %s is using MAP_PRIVATE, "
@@ -29,15 +29,9 @@
 #include <linux/sysctl.h>
 #include <linux/cpu.h>
 #include <linux/syscalls.h>
+#include <linux/workqueue.h>
 
-/*
- * The maximum number of pages to writeout in a single bdflush/kupdate
- * operation.  We do this so we don't hold I_LOCK against an inode for
- * enormous amounts of time, which would block a userspace task which has
- * been forced to throttle against that inode.  Also, the code reevaluates
- * the dirty each time it has written this many pages.
- */
-#define MAX_WRITEBACK_PAGES	1024
+#include <asm/div64.h>
 
 /*
  * After a CPU has dirtied this many pages, balance_dirty_pages_ratelimited
@@ -46,7 +40,6 @@
 static long ratelimit_pages = 32;
 
 static long total_pages;	/* The total number of pages in the machine. */
-static int dirty_exceeded;	/* Dirty mem may be over limit */
 
 /*
  * When balance_dirty_pages decides that the caller needs to perform some
@@ -62,7 +55,7 @@ static inline long sync_writeback_pages(void)
 /* The following parameters are exported via /proc/sys/vm */
 
 /*
- * Start background writeback (via pdflush) at this percentage
+ * Start background writeback (via the flushers) at this percentage
  */
 int dirty_background_ratio = 10;
 
@@ -96,9 +89,6 @@ EXPORT_SYMBOL(laptop_mode);
 
 /* End of sysctl-exported parameters */
 
-
-static void background_writeout(unsigned long _min_pages);
-
 struct writeback_state
 {
 	unsigned long nr_dirty;
@@ -107,12 +97,110 @@ struct writeback_state
 	unsigned long nr_writeback;
 };
 
+/*
+ * Each backing device is allowed a share of the dirty limit in proportion
+ * to its share of the writeout completed recently, so that a slow device
+ * cannot fill up all of the dirty memory and stall writers to fast ones.
+ *
+ * "Recently" is measured in completions, not time: vm_completions counts
+ * all of them, and every 2^writeout_period_shift completions a period
+ * ends.  A device's own count is halved for each period that has ended
+ * since it was last looked at, so the fraction
+ *
+ *	bdi->completions / (2^writeout_period_shift + completions this period)
+ *
+ * is a decaying average that adapts to a change in a device's speed within
+ * a couple of periods.  The period is sized to about twice the dirty limit.
+ */
+static atomic_t vm_completions = ATOMIC_INIT(0);
+static int writeout_period_shift;
+static DEFINE_SPINLOCK(writeout_period_lock);
+
+static int calc_period_shift(void)
+{
+	long dirty_total = (vm_dirty_ratio * total_pages) / 100;
+
+	if (dirty_total < 2)
+		dirty_total = 2;
+	return fls(dirty_total - 1) + 1;
+}
+
+static inline unsigned long writeout_period(unsigned int events)
+{
+	return events >> writeout_period_shift;
+}
+
+/*
+ * Halve bdi->completions once for each period that has gone by.
+ */
+static void bdi_writeout_age(struct backing_dev_info *bdi,
+			     unsigned long period)
+{
+	unsigned long flags;
+	unsigned long missed;
+
+	spin_lock_irqsave(&writeout_period_lock, flags);
+	missed = period - bdi->completions_period;
+	if (missed) {
+		int nr = atomic_read(&bdi->completions);
+
+		if (missed < 8 * sizeof(nr))
+			nr >>= missed;
+		else
+			nr = 0;
+		atomic_set(&bdi->completions, nr);
+		bdi->completions_period = period;
+	}
+	spin_unlock_irqrestore(&writeout_period_lock, flags);
+}
+
+/*
+ * Called when a page under writeback against @bdi has been written out.
+ */
+void bdi_writeout_inc(struct backing_dev_info *bdi)
+{
+	unsigned long period;
+
+	period = writeout_period(atomic_read(&vm_completions));
+	if (unlikely(bdi->completions_period != period))
+		bdi_writeout_age(bdi, period);
+	atomic_inc(&bdi->completions);
+	atomic_inc(&vm_completions);
+}
+EXPORT_SYMBOL(bdi_writeout_inc);
+
+/*
+ * Scale the global dirty limit down to @bdi's share of recent writeout.
+ */
+static long bdi_dirty_limit(struct backing_dev_info *bdi, long dirty)
+{
+	unsigned int events = atomic_read(&vm_completions);
+	unsigned long period = writeout_period(events);
+	long numerator, denominator;
+	u64 bdi_dirty;
+
+	if (bdi->completions_period != period)
+		bdi_writeout_age(bdi, period);
+
+	numerator = atomic_read(&bdi->completions);
+	denominator = (1L << writeout_period_shift) +
+		(events & ((1U << writeout_period_shift) - 1));
+
+	bdi_dirty = dirty;
+	bdi_dirty *= numerator;
+	do_div(bdi_dirty, denominator);
+	if (bdi_dirty > dirty)
+		bdi_dirty = dirty;
+
+	return bdi_dirty;
+}
+
 static void get_writeback_state(struct writeback_state *wbs)
 {
-	wbs->nr_dirty = read_page_state(nr_dirty);
-	wbs->nr_unstable = read_page_state(nr_unstable);
-	wbs->nr_mapped = read_page_state(nr_mapped);
-	wbs->nr_writeback = read_page_state(nr_writeback);
+	wbs->nr_dirty = global_page_state(NR_FILE_DIRTY);
+	wbs->nr_unstable = global_page_state(NR_UNSTABLE_NFS);
+	wbs->nr_mapped = global_page_state(NR_MAPPED);
+	wbs->nr_writeback = global_page_state(NR_WRITEBACK);
 }
 
 /*
@@ -185,40 +273,61 @@ get_dirty_limits(struct writeback_state *wbs, long *pbackground, long *pdirty,
 	*pdirty = dirty;
 }
 
+/*
+ * The global thresholds and @bdi's share of the dirty one, for reporting.
+ */
+void get_bdi_dirty_limits(struct backing_dev_info *bdi, long *pbackground,
+			  long *pdirty, long *pbdi_dirty)
+{
+	struct writeback_state wbs;
+
+	get_dirty_limits(&wbs, pbackground, pdirty, NULL);
+	*pbdi_dirty = bdi_dirty_limit(bdi, *pdirty);
+}
+EXPORT_SYMBOL(get_bdi_dirty_limits);
+
 /*
  * balance_dirty_pages() must be called by processes which are generating dirty
- * data.  It looks at the number of dirty pages in the machine and will force
- * the caller to perform writeback if the system is over `vm_dirty_ratio'.
- * If we're over `background_thresh' then pdflush is woken to perform some
- * writeout.
+ * data.  It looks at the number of dirty pages against the mapping's backing
+ * device and will force the caller to perform writeback if the device is over
+ * its share of `vm_dirty_ratio'.  If we're over `background_thresh' then
+ * the device's flusher thread is woken to perform some writeout.
  */
 static void balance_dirty_pages(struct address_space *mapping)
 {
 	struct writeback_state wbs;
-	long nr_reclaimable;
+	long nr_reclaimable, bdi_nr_reclaimable;
+	long bdi_nr_writeback;
 	long background_thresh;
 	long dirty_thresh;
+	long bdi_thresh;
 	unsigned long pages_written = 0;
 	unsigned long write_chunk = sync_writeback_pages();
 
 	struct backing_dev_info *bdi = mapping->backing_dev_info;
 
 	for (;;) {
-		struct writeback_control wbc = {
-			.bdi		= bdi,
-			.sync_mode	= WB_SYNC_NONE,
-			.older_than_this = NULL,
-			.nr_to_write	= write_chunk,
-		};
-		
 		/*获取后台线程开始回收的脏页面数background_thresh和应该堵住进程并开始回收的脏页面数dirty_thresh*/
 		get_dirty_limits(&wbs, &background_thresh,
 					&dirty_thresh, mapping);
+		bdi_thresh = bdi_dirty_limit(bdi, dirty_thresh);
 		nr_reclaimable = wbs.nr_dirty + wbs.nr_unstable;
-		if (nr_reclaimable + wbs.nr_writeback <= dirty_thresh)
+		bdi_nr_reclaimable = bdi_stat(bdi, BDI_RECLAIMABLE);
+		bdi_nr_writeback = bdi_stat(bdi, BDI_WRITEBACK);
+		if (bdi_nr_reclaimable + bdi_nr_writeback <= bdi_thresh)
+			break;
+
+		/*
+		 * Don't throttle anybody while the machine as a whole is well
+		 * below the limit: the device shares start out small and
+		 * only grow as writeout completes.
+		 */
+		if (nr_reclaimable + wbs.nr_writeback <=
+				(background_thresh + dirty_thresh) / 2)
 			break;
 
-		dirty_exceeded = 1;
+		if (!bdi->dirty_exceeded)
+			bdi->dirty_exceeded = 1;
 
 		/* Note: nr_reclaimable denotes nr_dirty + nr_unstable.
 		 * Unstable writes are a feature of certain networked
@@ -226,25 +335,29 @@ static void balance_dirty_pages(struct address_space *mapping)
 		 * written to the server's write cache, but has not yet
 		 * been flushed to permanent storage.
 		 */
-		if (nr_reclaimable) {
-			writeback_inodes(&wbc);
+		if (bdi_nr_reclaimable) {
+			pages_written += bdi_sync_writeback(bdi, NULL,
+						write_chunk, WB_SYNC_NONE);
 			get_dirty_limits(&wbs, &background_thresh,
 					&dirty_thresh, mapping);
+			bdi_thresh = bdi_dirty_limit(bdi, dirty_thresh);
 			nr_reclaimable = wbs.nr_dirty + wbs.nr_unstable;
-			if (nr_reclaimable + wbs.nr_writeback <= dirty_thresh)
+			bdi_nr_reclaimable = bdi_stat(bdi, BDI_RECLAIMABLE);
+			bdi_nr_writeback = bdi_stat(bdi, BDI_WRITEBACK);
+			if (bdi_nr_reclaimable + bdi_nr_writeback <= bdi_thresh)
 				break;
-			pages_written += write_chunk - wbc.nr_to_write;
 			if (pages_written >= write_chunk)
 				break;		/* We've done our duty */
 		}
 		blk_congestion_wait(WRITE, HZ/10);
 	}
 
-	if (nr_reclaimable + wbs.nr_writeback <= dirty_thresh)
-		dirty_exceeded = 0;
+	if (bdi_nr_reclaimable + bdi_nr_writeback <= bdi_thresh &&
+			bdi->dirty_exceeded)
+		bdi->dirty_exceeded = 0;
 
 	if (writeback_in_progress(bdi))
-		return;		/* pdflush is already working this queue */
+		return;		/* the flusher is already working this queue */
 
 	/*
 	 * In laptop mode, we wait until hitting the higher threshold before
@@ -256,44 +369,69 @@ static void balance_dirty_pages(struct address_space *mapping)
 	 */
 	if ((laptop_mode && pages_written) ||
 	     (!laptop_mode && (nr_reclaimable > background_thresh)))
-		pdflush_operation(background_writeout, 0);
+		bdi_wakeup_flusher(bdi);
 }
 
 /**
- * balance_dirty_pages_ratelimited - balance dirty memory state
+ * balance_dirty_pages_ratelimited_nr - balance dirty memory state
  * @mapping: address_space which was dirtied
+ * @nr_pages_dirtied: number of pages which the caller has just dirtied
  *
  * Processes which are dirtying memory should call in here once for each page
- * which was newly dirtied.  The function will periodically check the system's
- * dirty state and will initiate writeback if needed.
+ * which was newly dirtied, or once for a batch of them.  The function will
+ * periodically check the system's dirty state and will initiate writeback if
+ * needed.
  *
- * On really big machines, get_writeback_state is expensive, so try to avoid
- * calling it too often (ratelimiting).  But once we're over the dirty memory
- * limit we decrease the ratelimiting by a lot, to prevent individual processes
- * from overshooting the limit by (ratelimit_pages) each.
+ * Reading the dirty state is cheap, but balance_dirty_pages() does a good
+ * deal more than that, so try to avoid calling it too often (ratelimiting).
+ * But once we're over the dirty memory limit we decrease the ratelimiting by
+ * a lot, to prevent individual processes from overshooting the limit by
+ * (ratelimit_pages) each.
  */
-void balance_dirty_pages_ratelimited(struct address_space *mapping)
+void balance_dirty_pages_ratelimited_nr(struct address_space *mapping,
+					unsigned long nr_pages_dirtied)
 {
-	static DEFINE_PER_CPU(int, ratelimits) = 0;
-	long ratelimit;
+	static DEFINE_PER_CPU(unsigned long, ratelimits) = 0;
+	unsigned long ratelimit;
+	unsigned long *p;
 
 	ratelimit = ratelimit_pages;
-	if (dirty_exceeded)
+	if (mapping->backing_dev_info->dirty_exceeded)
 		ratelimit = 8;
 
 	/*
 	 * Check the rate limiting. Also, we do not want to throttle real-time
 	 * tasks in balance_dirty_pages(). Period.
 	 */
-	if (get_cpu_var(ratelimits)++ >= ratelimit) {
-		__get_cpu_var(ratelimits) = 0;
+	p = &get_cpu_var(ratelimits);
+	*p += nr_pages_dirtied;
+	if (*p >= ratelimit) {
+		*p = 0;
 		put_cpu_var(ratelimits);
 		balance_dirty_pages(mapping);
 		return;
 	}
 	put_cpu_var(ratelimits);
 }
-EXPORT_SYMBOL(balance_dirty_pages_ratelimited);
+EXPORT_SYMBOL(balance_dirty_pages_ratelimited_nr);
+
+/**
+ * set_page_dirty_balance - dirty a page written through a shared mapping
+ * @page: the page, which the caller holds a reference on
+ *
+ * Called after the pte lock is dropped by the write fault that made a
+ * shared writable pte dirty, so that mmap writers are throttled like
+ * write(2) ones instead of dirtying all of memory behind our back.
+ */
+void set_page_dirty_balance(struct page *page)
+{
+	struct address_space *mapping;
+
+	set_page_dirty(page);
+	mapping = page_mapping(page);
+	if (mapping)
+		balance_dirty_pages_ratelimited(mapping);
+}
 
 void throttle_vm_writeout(void)
 {
@@ -316,135 +454,24 @@ void throttle_vm_writeout(void)
         }
 }
 
-
 /*
- * writeback at least _min_pages, and keep writing until the amount of dirty
- * memory is less than the background threshold, or until we're all clean.
+ * Whether the machine as a whole has more dirty memory than it should keep
+ * around: the flushers write until this is false again.
  */
-static void background_writeout(unsigned long _min_pages)
+int over_bground_thresh(void)
 {
-	long min_pages = _min_pages;
-	struct writeback_control wbc = {
-		.bdi		= NULL,
-		.sync_mode	= WB_SYNC_NONE,
-		.older_than_this = NULL,
-		.nr_to_write	= 0,
-		.nonblocking	= 1,
-	};
-
-	for ( ; ; ) {
-		struct writeback_state wbs;
-		long background_thresh;
-		long dirty_thresh;
-		/*获取后台线程开始回收的脏页面阀值background_thresh和应该堵住进程并开始回收的脏页面阀值dirty_thresh*/
-		get_dirty_limits(&wbs, &background_thresh, &dirty_thresh, NULL);
-		/*如果脏页数量低于阀值background_thresh，且min_pages为0，则终止*/
-		if (wbs.nr_dirty + wbs.nr_unstable < background_thresh
-				&& min_pages <= 0)
-			break;
-		wbc.encountered_congestion = 0;
-		wbc.nr_to_write = MAX_WRITEBACK_PAGES;
-		wbc.pages_skipped = 0;
-		/*尝试写入1024个脏页*/
-		writeback_inodes(&wbc);
-		/*减少需要写的页的数量*/
-		min_pages -= MAX_WRITEBACK_PAGES - wbc.nr_to_write;
-		/*如果还有页面没有写或略过一些页面，可能快设备的请求队列处于拥塞状态*/
-		if (wbc.nr_to_write > 0 || wbc.pages_skipped > 0) {
-			/* Wrote less than expected */
-			/*睡眠100ms*/
-			blk_congestion_wait(WRITE, HZ/10);
-			if (!wbc.encountered_congestion)
-				break;
-		}
-	}
-}
-
-/*
- * Start writeback of `nr_pages' pages.  If `nr_pages' is zero, write back
- * the whole world.  Returns 0 if a pdflush thread was dispatched.  Returns
- * -1 if all pdflush threads were busy.
- */
-int wakeup_pdflush(long nr_pages)
-{
-	if (nr_pages == 0) {
-		struct writeback_state wbs;
+	struct writeback_state wbs;
+	long background_thresh;
+	long dirty_thresh;
 
-		get_writeback_state(&wbs);
-		nr_pages = wbs.nr_dirty + wbs.nr_unstable;
-	}
-	return pdflush_operation(background_writeout, nr_pages);
+	get_dirty_limits(&wbs, &background_thresh, &dirty_thresh, NULL);
+	return wbs.nr_dirty + wbs.nr_unstable >= background_thresh;
 }
 
-static void wb_timer_fn(unsigned long unused);
 static void laptop_timer_fn(unsigned long unused);
 
-static DEFINE_TIMER(wb_timer, wb_timer_fn, 0, 0);
 static DEFINE_TIMER(laptop_mode_wb_timer, laptop_timer_fn, 0, 0);
 
-/*
- * Periodic writeback of "old" data.
- *
- * Define "old": the first time one of an inode's pages is dirtied, we mark the
- * dirtying-time in the inode's address_space.  So this periodic writeback code
- * just walks the superblock inode list, writing back any inodes which are
- * older than a specific point in time.
- *
- * Try to run once per dirty_writeback_centisecs.  But if a writeback event
- * takes longer than a dirty_writeback_centisecs interval, then leave a
- * one-second gap.
- *
- * older_than_this takes precedence over nr_to_write.  So we'll only write back
- * all dirty pages if they are all attached to "old" mappings.
- */
-static void wb_kupdate(unsigned long arg)
-{
-	unsigned long oldest_jif;
-	unsigned long start_jif;
-	unsigned long next_jif;
-	long nr_to_write;
-	struct writeback_state wbs;
-	struct writeback_control wbc = {
-		.bdi		= NULL,
-		.sync_mode	= WB_SYNC_NONE,
-		.older_than_this = &oldest_jif,
-		.nr_to_write	= 0,
-		.nonblocking	= 1,
-		.for_kupdate	= 1,
-	};
-	/*将脏的超级快写到磁盘中*/
-	sync_supers();
-
-	get_writeback_state(&wbs);
-	/*计算本次到期时间*/
-	oldest_jif = jiffies - (dirty_expire_centisecs * HZ) / 100;
-	/*计算下一次到期时间*/
-	start_jif = jiffies;
-	next_jif = start_jif + (dirty_writeback_centisecs * HZ) / 100;
-	/*计算本次要写入的脏数据量*/
-	nr_to_write = wbs.nr_dirty + wbs.nr_unstable +
-			(inodes_stat.nr_inodes - inodes_stat.nr_unused);
-	while (nr_to_write > 0) {
-		wbc.encountered_congestion = 0;
-		wbc.nr_to_write = MAX_WRITEBACK_PAGES;
-		writeback_inodes(&wbc);
-		if (wbc.nr_to_write > 0) {
-			/*如果底层块设备发生阻塞则睡眠一段时间*/
-			if (wbc.encountered_congestion)
-				blk_congestion_wait(WRITE, HZ/10);
-			else
-				/*将过去oldest_jif时间的脏数据都写完了*/
-				break;	/* All the old data is written */
-		}
-		nr_to_write -= MAX_WRITEBACK_PAGES - wbc.nr_to_write;
-	}
-	/*如果本次执行时间太长，就从现在开始1S后到期*/
-	if (time_before(next_jif, jiffies + HZ))
-		next_jif = jiffies + HZ;
-	if (dirty_writeback_centisecs)
-		mod_timer(&wb_timer, next_jif);
-}
-
 /*
  * sysctl handler for /proc/sys/vm/dirty_writeback_centisecs
  */
@@ -452,29 +479,43 @@ int dirty_writeback_centisecs_handler(ctl_table *table, int write,
 		struct file *file, void __user *buffer, size_t *length, loff_t *ppos)
 {
 	proc_dointvec(table, write, file, buffer, length, ppos);
-	if (dirty_writeback_centisecs) {
-		mod_timer(&wb_timer,
-			jiffies + (dirty_writeback_centisecs * HZ) / 100);
-	} else {
-		del_timer(&wb_timer);
-	}
+	/* let the flushers pick up the new interval */
+	if (write)
+		bdi_wakeup_flushers();
 	return 0;
 }
 
-static void wb_timer_fn(unsigned long unused)
+/*
+ * sysctl handler for /proc/sys/vm/dirty_ratio: the writeout period follows
+ * the dirty limit.
+ */
+int dirty_ratio_handler(ctl_table *table, int write,
+		struct file *file, void __user *buffer, size_t *length, loff_t *ppos)
 {
-	if (pdflush_operation(wb_kupdate, 0) < 0)
-		mod_timer(&wb_timer, jiffies + HZ); /* delay 1 second */
+	int old_ratio = vm_dirty_ratio;
+	int ret;
+
+	ret = proc_dointvec_minmax(table, write, file, buffer, length, ppos);
+	if (ret == 0 && write && vm_dirty_ratio != old_ratio)
+		writeout_period_shift = calc_period_shift();
+	return ret;
 }
 
-static void laptop_flush(unsigned long unused)
+/*
+ * The laptop mode flush starts writeback of everything on all devices; the
+ * flushers do the rest.  It is done from keventd since the timer runs in
+ * interrupt context and starting a flusher may have to allocate.
+ */
+static void laptop_flush(void *unused)
 {
-	sys_sync();
+	wakeup_flusher_threads(0);
 }
 
+static DECLARE_WORK(laptop_flush_work, laptop_flush, NULL);
+
 static void laptop_timer_fn(unsigned long unused)
 {
-	pdflush_operation(laptop_flush, 0);
+	schedule_work(&laptop_flush_work);
 }
 
 /*
@@ -500,8 +541,8 @@ void laptop_sync_completion(void)
 /*
  * If ratelimit_pages is too high then we can get into dirty-data overload
  * if a large number of processes all perform writes at the same time.
- * If it is too low then SMP machines will call the (expensive)
- * get_writeback_state too often.
+ * If it is too low then SMP machines will call balance_dirty_pages() too
+ * often.
  *
  * Here we set ratelimit_pages to a level which ensures that when all CPUs are
  * dirtying in parallel, we cannot go more than 3% (1/32) over the dirty memory
@@ -561,8 +602,13 @@ void __init page_writeback_init(void)
 		if (vm_dirty_ratio <= 0)
 			vm_dirty_ratio = 1;
 	}
-	/*定义定时器回写陈旧的脏页*/
-	mod_timer(&wb_timer, jiffies + (dirty_writeback_centisecs * HZ) / 100);
+	writeout_period_shift = calc_period_shift();
+	/*
+	 * Inodes are dirtied long before the initcalls run: the default
+	 * device has to be able to take them from the start.  Its flusher
+	 * is started by the forker once that is up.
+	 */
+	bdi_init(&default_backing_dev_info);
 	set_ratelimit();
 	register_cpu_notifier(&ratelimit_nb);
 }
@@ -644,8 +690,12 @@ int __set_page_dirty_nobuffers(struct page *page)
 			mapping2 = page_mapping(page);
 			if (mapping2) { /* Race with truncate? */
 				BUG_ON(mapping2 != mapping);
-				if (mapping_cap_account_dirty(mapping))
-					inc_page_state(nr_dirty);
+				if (mapping_cap_account_dirty(mapping)) {
+					__inc_zone_page_state(page,
+							NR_FILE_DIRTY);
+					inc_bdi_stat(mapping->backing_dev_info,
+							BDI_RECLAIMABLE);
+				}
 				radix_tree_tag_set(&mapping->page_tree,
 					page_index(page), PAGECACHE_TAG_DIRTY);
 			}
@@ -730,8 +780,11 @@ int test_clear_page_dirty(struct page *page)
 						page_index(page),
 						PAGECACHE_TAG_DIRTY);
 			write_unlock_irqrestore(&mapping->tree_lock, flags);
-			if (mapping_cap_account_dirty(mapping))
-				dec_page_state(nr_dirty);
+			if (mapping_cap_account_dirty(mapping)) {
+				dec_zone_page_state(page, NR_FILE_DIRTY);
+				dec_bdi_stat(mapping->backing_dev_info,
+						BDI_RECLAIMABLE);
+			}
 			return 1;
 		}
 		write_unlock_irqrestore(&mapping->tree_lock, flags);
@@ -760,9 +813,20 @@ int clear_page_dirty_for_io(struct page *page)
 	struct address_space *mapping = page_mapping(page);
 
 	if (mapping) {
+		/*
+		 * Write-protect the shared mappings first, so that a store
+		 * made after this point faults and dirties the page again.
+		 * Dirty bits found in the ptes move to the page here, and
+		 * the writeout below covers them.
+		 */
+		if (mapping_cap_account_dirty(mapping) && page_mkclean(page))
+			set_page_dirty(page);
 		if (TestClearPageDirty(page)) {
-			if (mapping_cap_account_dirty(mapping))
-				dec_page_state(nr_dirty);
+			if (mapping_cap_account_dirty(mapping)) {
+				dec_zone_page_state(page, NR_FILE_DIRTY);
+				dec_bdi_stat(mapping->backing_dev_info,
+						BDI_RECLAIMABLE);
+			}
 			return 1;
 		}
 		return 0;
@@ -781,10 +845,16 @@ int test_clear_page_writeback(struct page *page)
 
 		write_lock_irqsave(&mapping->tree_lock, flags);
 		ret = TestClearPageWriteback(page);
-		if (ret)
+		if (ret) {
 			radix_tree_tag_clear(&mapping->page_tree,
 						page_index(page),
 						PAGECACHE_TAG_WRITEBACK);
+			if (mapping_cap_account_dirty(mapping)) {
+				dec_bdi_stat(mapping->backing_dev_info,
+						BDI_WRITEBACK);
+				bdi_writeout_inc(mapping->backing_dev_info);
+			}
+		}
 		write_unlock_irqrestore(&mapping->tree_lock, flags);
 	} else {
 		ret = TestClearPageWriteback(page);
@@ -802,10 +872,14 @@ int test_set_page_writeback(struct page *page)
 
 		write_lock_irqsave(&mapping->tree_lock, flags);
 		ret = TestSetPageWriteback(page);
-		if (!ret)
+		if (!ret) {
 			radix_tree_tag_set(&mapping->page_tree,
 						page_index(page),
 						PAGECACHE_TAG_WRITEBACK);
+			if (mapping_cap_account_dirty(mapping))
+				inc_bdi_stat(mapping->backing_dev_info,
+						BDI_WRITEBACK);
+		}
 		if (!PageDirty(page))
 			radix_tree_tag_clear(&mapping->page_tree,
 						page_index(page),
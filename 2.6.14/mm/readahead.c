@@ -47,21 +47,6 @@ static inline unsigned long get_max_readahead(struct file_ra_state *ra)
 	return ra->ra_pages;
 }
 
-static inline unsigned long get_min_readahead(struct file_ra_state *ra)
-{
-	return (VM_MIN_READAHEAD * 1024) / PAGE_CACHE_SIZE;
-}
-
-static inline void ra_off(struct file_ra_state *ra)
-{
-	ra->start = 0;
-	ra->flags = 0;
-	ra->size = 0;
-	ra->ahead_start = 0;
-	ra->ahead_size = 0;
-	return;
-}
-
 /*
  * Set the initial window size, round to next power of 2 and square
  * for small size, x 4 for medium, and x 2 for large
@@ -82,25 +67,19 @@ static unsigned long get_init_ra_size(unsigned long size, unsigned long max)
 }
 
 /*
- * Set the new window size, this is called only when I/O is to be submitted,
- * not for each call to readahead.  If a cache miss occured, reduce next I/O
- * size, else increase depending on how close to max we are.
+ * Get the size of the next readahead from the previous one: ramp up fast
+ * while it is small, then double it up to the maximum.
  */
-static inline unsigned long get_next_ra_size(struct file_ra_state *ra)
+static inline unsigned long get_next_ra_size(struct file_ra_state *ra,
+					     unsigned long max)
 {
-	unsigned long max = get_max_readahead(ra);
-	unsigned long min = get_min_readahead(ra);
 	unsigned long cur = ra->size;
 	unsigned long newsize;
 
-	if (ra->flags & RA_FLAG_MISS) {
-		ra->flags &= ~RA_FLAG_MISS;
-		newsize = max((cur - 2), min);
-	} else if (cur < max / 16) {
+	if (cur < max / 16)
 		newsize = 4 * cur;
-	} else {
+	else
 		newsize = 2 * cur;
-	}
 	return min(newsize, max);
 }
 
@@ -186,59 +165,34 @@ out:
 /*
  * Readahead design.
  *
- * The fields in struct file_ra_state represent the most-recently-executed
- * readahead attempt:
- *
- * start:	Page index at which we started the readahead
- * size:	Number of pages in that read
- *              Together, these form the "current window".
- *              Together, start and size represent the `readahead window'.
- * prev_page:   The page which the readahead algorithm most-recently inspected.
- *              It is mainly used to detect sequential file reading.
- *              If page_cache_readahead sees that it is again being called for
- *              a page which it just looked at, it can return immediately without
- *              making any state changes.
- * ahead_start,
- * ahead_size:  Together, these form the "ahead window".
- * ra_pages:	The externally controlled max readahead for this fd.
- *
- * When readahead is in the off state (size == 0), readahead is disabled.
- * In this state, prev_page is used to detect the resumption of sequential I/O.
- *
- * The readahead code manages two windows - the "current" and the "ahead"
- * windows.  The intent is that while the application is walking the pages
- * in the current window, I/O is underway on the ahead window.  When the
- * current window is fully traversed, it is replaced by the ahead window
- * and the ahead window is invalidated.  When this copying happens, the
- * new current window's pages are probably still locked.  So
- * we submit a new batch of I/O immediately, creating a new ahead window.
- *
- * So:
- *
- *   ----|----------------|----------------|-----
- *       ^start           ^start+size
- *                        ^ahead_start     ^ahead_start+ahead_size
+ * Readahead is done on demand: page_cache_sync_readahead() is called when a
+ * read misses the pagecache, page_cache_async_readahead() when it hits a
+ * page that carries the PG_readahead marker.  The marker is set on the
+ * first page of the last `async_size' pages of each readahead batch, so
+ * that the next batch is submitted while the reader is still consuming the
+ * current one:
  *
- *         ^ When this page is read, we submit I/O for the
- *           ahead window.
+ *   ----|--------------------|-----------------|-----
+ *       ^start               ^marker           ^start+size
+ *                            |<-- async_size ->|
  *
- * A `readahead hit' occurs when a read request is made against a page which is
- * the next sequential page. Ahead window calculations are done only when it
- * is time to submit a new IO.  The code ramps up the size agressively at first,
- * but slow down as it approaches max_readhead.
+ * The fields in struct file_ra_state describe the most recent readahead:
  *
- * Any seek/ramdom IO will result in readahead being turned off.  It will resume
- * at the first sequential access.
- *
- * There is a special-case: if the first page which the application tries to
- * read happens to be the first page of the file, it is assumed that a linear
- * read is about to happen and the window is immediately set to the initial size
- * based on I/O request size and the max_readahead.
+ * start:	Page index at which it started
+ * size:	Number of pages it read
+ * async_size:	Pages left unread when the marker is hit
+ * prev_page:	The page which was most recently read.  Used to detect
+ *		sequential reading after a pagecache miss.
+ * ra_pages:	The externally controlled max readahead for this fd.
  *
- * This function is to be called for every read request, rather than when
- * it is time to perform readahead.  It is called only once for the entire I/O
- * regardless of size unless readahead is unable to start enough I/O to satisfy
- * the request (I/O request > max_readahead).
+ * If the reader hits the marker where this state expects it, the window is
+ * pushed forward and grown.  If it hits a marker that the state doesn't
+ * know about, because several streams share the file (and so its
+ * file_ra_state) or because of a seek, the size is inferred from the pages
+ * that are already cached ahead of the marker instead: the marker itself
+ * says the access is sequential.  So there is no per-file "window" to lose
+ * on a seek or to be trampled by an interleaved reader; small random reads
+ * only read what was asked for and leave the state alone.
  */
 
 /*
@@ -255,7 +209,8 @@ out:
 /*批量分配page并从磁盘读取nr_to_read个页面,返回实际分配page的个数*/
 static int
 __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
-			unsigned long offset, unsigned long nr_to_read)
+			unsigned long offset, unsigned long nr_to_read,
+			unsigned long lookahead_size)
 {
 	struct inode *inode = mapping->host;
 	struct page *page;
@@ -291,6 +246,8 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 			break;
 		page->index = page_offset;
 		list_add(&page->lru, &page_pool);
+		if (page_idx == nr_to_read - lookahead_size)
+			SetPageReadahead(page);
 		ret++;
 	}
 	read_unlock_irq(&mapping->tree_lock);
@@ -327,7 +284,7 @@ int force_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		if (this_chunk > nr_to_read)
 			this_chunk = nr_to_read;
 		err = __do_page_cache_readahead(mapping, filp,
-						offset, this_chunk);
+						offset, this_chunk, 0);
 		if (err < 0) {
 			ret = err;
 			break;
@@ -339,30 +296,6 @@ int force_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	return ret;
 }
 
-/*
- * Check how effective readahead is being.  If the amount of started IO is
- * less than expected then the file is partly or fully in pagecache and
- * readahead isn't helping.
- *
- */
-/*评估预读效果，效果好返回1，效果不好返回0*/
-static inline int check_ra_success(struct file_ra_state *ra,
-			unsigned long nr_to_read, unsigned long actual)
-{
-	/*要读取的页面已经在page cache*/
-	if (actual == 0) {
-		ra->cache_hit += nr_to_read;
-		if (ra->cache_hit >= VM_MAX_CACHE_HIT) {
-			ra_off(ra);
-			ra->flags |= RA_FLAG_INCACHE;
-			return 0;
-		}
-	} else {
-		ra->cache_hit=0;
-	}
-	return 1;
-}
-
 /*
  * This version skips the IO if the queue is read-congested, and will tell the
  * block layer to abandon the readahead if request allocation would block.
@@ -376,228 +309,174 @@ int do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	if (bdi_read_congested(mapping->backing_dev_info))
 		return -1;
 
-	return __do_page_cache_readahead(mapping, filp, offset, nr_to_read);
+	return __do_page_cache_readahead(mapping, filp, offset, nr_to_read, 0);
 }
 
 /*
- * Read 'nr_to_read' pages starting at page 'offset'. If the flag 'block'
- * is set wait till the read completes.  Otherwise attempt to read without
- * blocking.
- * Returns 1 meaning 'success' if read is succesfull without switching off
- * readhaead mode. Otherwise return failure.
+ * Submit the readahead described by @ra, with its marker.
  */
+static unsigned long ra_submit(struct file_ra_state *ra,
+			       struct address_space *mapping, struct file *filp)
+{
+	return __do_page_cache_readahead(mapping, filp,
+					ra->start, ra->size, ra->async_size);
+}
+
 /*
- * 批量分配page并从磁盘预读页面
- *
- * @offset：要预读的文件的起始页面
- * @nr_to_read: 要预读的页面数
- * @block:是否阻塞
- * 
- * @return: 返回预读效果，1：好，0：不好
+ * Find the first page at or after @index, within @max_scan pages, that is
+ * not in the pagecache.  Returns @index + @max_scan if there is none.
  */
-static int
-blockable_page_cache_readahead(struct address_space *mapping, struct file *filp,
-			unsigned long offset, unsigned long nr_to_read,
-			struct file_ra_state *ra, int block)
+static pgoff_t find_next_uncached(struct address_space *mapping,
+				  pgoff_t index, unsigned long max_scan)
 {
-	int actual;
-
-	/*bdi_read_congested判断块设备的请求队列是否读拥塞的,如果是则退出*/
-	if (!block && bdi_read_congested(mapping->backing_dev_info))
-		return 0;
-	/*批量分配page并从磁盘读取nr_to_read个页面,返回实际分配page的个数*/
-	actual = __do_page_cache_readahead(mapping, filp, offset, nr_to_read);
+	unsigned long i;
 
-	/*评估并返回预读效果的好坏，好返回1，不好返回0*/
-	return check_ra_success(ra, nr_to_read, actual);
-}
-/*创建预读窗口并填充*/
-static int make_ahead_window(struct address_space *mapping, struct file *filp,
-				struct file_ra_state *ra, int force)
-{
-	int block, ret;
-
-	/*预读窗口长度与当前窗口长度相关*/
-	ra->ahead_size = get_next_ra_size(ra);
-	/*预读窗口认为是从当前窗口的最后一页开始*/
-	ra->ahead_start = ra->start + ra->size;
-
-	block = force || (ra->prev_page >= ra->ahead_start);
-	/*批量分配page并从磁盘预读ra->ahead_size个页面*/
-	ret = blockable_page_cache_readahead(mapping, filp,
-			ra->ahead_start, ra->ahead_size, ra, block);
-	
-	/*如果预读效果不好，则说明页面都在page cache，重置预读窗口*/
-	if (!ret && !force) {
-		/* A read failure in blocking mode, implies pages are
-		 * all cached. So we can safely assume we have taken
-		 * care of all the pages requested in this call.
-		 * A read failure in non-blocking mode, implies we are
-		 * reading more pages than requested in this call.  So
-		 * we safely assume we have taken care of all the pages
-		 * requested in this call.
-		 *
-		 * Just reset the ahead window in case we failed due to
-		 * congestion.  The ahead window will any way be closed
-		 * in case we failed due to excessive page cache hits.
-		 */
-		ra->ahead_start = 0;
-		ra->ahead_size = 0;
+	read_lock_irq(&mapping->tree_lock);
+	for (i = 0; i < max_scan; i++) {
+		if (!radix_tree_lookup(&mapping->page_tree, index))
+			break;
+		index++;
 	}
-
-	return ret;
+	read_unlock_irq(&mapping->tree_lock);
+	return index;
 }
 
 /*
- * page_cache_readahead is the main function.  If performs the adaptive
- * readahead window size management and submits the readahead I/O.
- */
-/* 
- * 处理非特殊系统调用显式触发的所有预读操作
- * 填充当前窗和预读窗，根据预读命中数更新当前窗和预读窗的大小
- * 也就是根据过去对文件访问预读策略的成功程度来调整
- * 当内核必须满足对某个文件一页或多页的读请求时，函数被调用
- *
- * 如下几种情况会触发执行预读算法：
- * a.内核用用户态请求来读文件数据页时（如do_generic_file_read）
- * b.当内核为文件内存映射分配一页
- * c.用户态执行readahead系统调用
- * d.用户态应用使用POSIX_FADV_NOREUSE或POSIX_FADV_WILLNEED命令执行posix_fadvise()系统调用
- * e.用户态应用使用MADV_WILLNEED命令执行madvise系统调用
- *
- * @ra: 包含该页的文件file_ra_state描述符指针
- * @offset:文件内页的偏移量(单位：页)
- * @req_size: 要完成当前读操作还需要读的页数
+ * A minimal readahead algorithm for trivial sequential/random reads.
  */
-unsigned long
-page_cache_readahead(struct address_space *mapping, struct file_ra_state *ra,
-		     struct file *filp, unsigned long offset,
-		     unsigned long req_size)
+static unsigned long
+ondemand_readahead(struct address_space *mapping,
+		   struct file_ra_state *ra, struct file *filp,
+		   int hit_readahead_marker, pgoff_t offset,
+		   unsigned long req_size)
 {
-	unsigned long max, newsize;
-	int sequential;
-	
-	/* =====step1: pre-init */
+	unsigned long max = get_max_readahead(ra);
+
 	/*
-	 * We avoid doing extra work and bogusly perturbing the readahead
-	 * window expansion logic.
+	 * start of file
 	 */
-	/*如果请求页与上一次最后访问页相同,并且读取的页数大于一页，则递增offset*/
-	if (offset == ra->prev_page && --req_size)
-		++offset;
-
-	/* =====setep2: init current window */
-	/* Note that prev_page == -1 if it is a first read */
-	/*如果请求页与上次访问的最后一页相邻，则内核认为是顺序访问*/
-	sequential = (offset == ra->prev_page + 1);
-	/*初始化当前窗上次访问的最后一页索引为offset*/
-	ra->prev_page = offset;
-
-	/*获取需要的预读量newsize*/
-	max = get_max_readahead(ra);
-	newsize = min(req_size, max);
-
-	/* No readahead or sub-page sized read or file already in cache */
-	/* 如果需要预读页数为0或者所请求的全部256页都在page cache
-	 */
-	if (newsize == 0 || (ra->flags & RA_FLAG_INCACHE))
-		goto out;
-
-	/*更新进程上一次访问的最后一页的索引*/
-	ra->prev_page += newsize - 1;
+	if (!offset)
+		goto initial_readahead;
 
+	/*
+	 * It's the expected callback offset: assume sequential access, ramp
+	 * up the size and push the window forward.
+	 */
+	if (offset == ra->start + ra->size - ra->async_size ||
+	    offset == ra->start + ra->size) {
+		ra->start += ra->size;
+		ra->size = get_next_ra_size(ra, max);
+		ra->async_size = ra->size;
+		goto readit;
+	}
 
-	/* =====step3: fill up current window*/
 	/*
-	 * Special case - first read at start of file. We'll assume it's
-	 * a whole-file read and grow the window fast.  Or detect first
-	 * sequential access
+	 * Hit a marked page without valid readahead state, e.g. interleaved
+	 * reads.  The pages cached after it tell how large the readahead
+	 * that set the marker was, which normally equals its async_size.
 	 */
-	/*如果当前窗为空且是顺序访问,填充当前窗*/
-	if (sequential && ra->size == 0) {
-		/*设定当前窗，按请求页数确定起始请求页和长度*/
-		ra->size = get_init_ra_size(newsize, max);
-		ra->start = offset;
-		/*从批量读取读ra->size个页，且是阻塞读*/
-		if (!blockable_page_cache_readahead(mapping, filp, offset,
-							 ra->size, ra, 1))
-			goto out;
-
-		/*
-		 * If the request size is larger than our max readahead, we
-		 * at least want to be sure that we get 2 IOs in flight and
-		 * we know that we will definitly need the new I/O.
-		 * once we do this, subsequent calls should be able to overlap
-		 * IOs,* thus preventing stalls. so issue the ahead window
-		 * immediately.
-		 */
-		/*如果请求页大于最大允许的预读量，则需要创建预读窗口*/
-		if (req_size >= max)
-			/*创建预读窗口并填充*/
-			make_ahead_window(mapping, filp, ra, 1);
+	if (hit_readahead_marker) {
+		pgoff_t start;
 
-		goto out;
+		start = find_next_uncached(mapping, offset + 1, max);
+		if (start - offset > max)
+			return 0;
+
+		ra->start = start;
+		ra->size = start - offset;	/* old async_size */
+		ra->size += req_size;
+		ra->size = get_next_ra_size(ra, max);
+		ra->async_size = ra->size;
+		goto readit;
 	}
 
 	/*
-	 * Now handle the random case:
-	 * partial page reads and first access were handled above,
-	 * so this must be the next page otherwise it is random
+	 * oversize read
 	 */
-	/*随机访问，关闭预读*/
-	if (!sequential) {
-		/*清空预读窗和当前窗*/
-		ra_off(ra);
-		blockable_page_cache_readahead(mapping, filp, offset,
-				 newsize, ra, 1);
-		goto out;
-	}
+	if (req_size > max)
+		goto initial_readahead;
 
 	/*
-	 * If we get here we are doing sequential IO and this was not the first
-	 * occurence (ie we have an existing window)
+	 * sequential cache miss
 	 */
-	/*到此内核皆认为是顺序读，预读窗不存在，则创建预读窗*/
-	if (ra->ahead_start == 0) {	 /* no ahead window yet */
-		/*创建预读窗口并填充*/
-		if (!make_ahead_window(mapping, filp, ra, 0))
-			goto out;
-	}
+	if (offset - ra->prev_page <= 1UL)
+		goto initial_readahead;
+
 	/*
-	 * Already have an ahead window, check if we crossed into it.
-	 * If so, shift windows and issue a new ahead window.
-	 * Only return the #pages that are in the current window, so that
-	 * we get called back on the first page of the ahead window which
-	 * will allow us to submit more IO.
+	 * standalone, small random read:
+	 * read as is, and do not pollute the readahead state
 	 */
-	/*如果当前窗穿越了预读窗，则将预读窗变为当前窗，并创建新的预读窗*/
-	if (ra->prev_page >= ra->ahead_start) {
-		ra->start = ra->ahead_start;
-		ra->size = ra->ahead_size;
-		/*创建预读窗口并填充*/
-		make_ahead_window(mapping, filp, ra, 0);
-	}
+	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
 
-out:
-	return ra->prev_page + 1;
+initial_readahead:
+	ra->start = offset;
+	ra->size = get_init_ra_size(req_size, max);
+	ra->async_size = ra->size > req_size ? ra->size - req_size : ra->size;
+
+readit:
+	return ra_submit(ra, mapping, filp);
 }
 
-/*
- * handle_ra_miss() is called when it is known that a page which should have
- * been present in the pagecache (we just did some readahead there) was in fact
- * not found.  This will happen if it was evicted by the VM (readahead
- * thrashing)
+/**
+ * page_cache_sync_readahead - generic file readahead
+ * @mapping: address_space which holds the pagecache and I/O vectors
+ * @ra: file_ra_state which holds the readahead state
+ * @filp: passed on to ->readpage() and ->readpages()
+ * @offset: start offset into @mapping, in pagecache page-sized units
+ * @req_size: hint: total size of the read which the caller is performing in
+ *            pagecache pages
  *
- * Turn on the cache miss flag in the RA struct, this will cause the RA code
- * to reduce the RA size on the next read.
+ * page_cache_sync_readahead() should be called when a cache miss happened:
+ * it will submit the read.  The readahead logic may decide to piggyback
+ * more pages onto the read request if access patterns suggest it will
+ * improve performance.
  */
-/*开启RA_FLAG_MISS引发下次预读减少预读大小*/
-void handle_ra_miss(struct address_space *mapping,
-		struct file_ra_state *ra, pgoff_t offset)
+void page_cache_sync_readahead(struct address_space *mapping,
+			       struct file_ra_state *ra, struct file *filp,
+			       pgoff_t offset, unsigned long req_size)
 {
-	ra->flags |= RA_FLAG_MISS;
-	ra->flags &= ~RA_FLAG_INCACHE;
-	ra->cache_hit = 0;
+	/* no read-ahead */
+	if (!ra->ra_pages)
+		return;
+
+	/* do read-ahead */
+	ondemand_readahead(mapping, ra, filp, 0, offset, req_size);
+}
+
+/**
+ * page_cache_async_readahead - file readahead for marked pages
+ * @mapping: address_space which holds the pagecache and I/O vectors
+ * @ra: file_ra_state which holds the readahead state
+ * @filp: passed on to ->readpage() and ->readpages()
+ * @page: the page at @offset which has the PG_readahead flag set
+ * @offset: start offset into @mapping, in pagecache page-sized units
+ * @req_size: hint: total size of the read which the caller is performing in
+ *            pagecache pages
+ *
+ * page_cache_async_readahead() should be called when a page is used which
+ * has the PG_readahead flag: this is a marker to suggest that the
+ * application has used up enough of the readahead window that we should
+ * start pulling in more pages.
+ */
+void page_cache_async_readahead(struct address_space *mapping,
+				struct file_ra_state *ra, struct file *filp,
+				struct page *page, pgoff_t offset,
+				unsigned long req_size)
+{
+	/* no read-ahead */
+	if (!ra->ra_pages)
+		return;
+
+	ClearPageReadahead(page);
+
+	/*
+	 * Defer asynchronous read-ahead on IO congestion.
+	 */
+	if (bdi_read_congested(mapping->backing_dev_info))
+		return;
+
+	/* do read-ahead */
+	ondemand_readahead(mapping, ra, filp, 1, offset, req_size);
 }
 
 /*
@@ -456,6 +456,91 @@ int page_referenced(struct page *page, int is_locked, int ignore_token)
 	return referenced;
 }
 
+/*
+ * Write-protect and clean one pte mapping @page, so that the next write
+ * through it faults and dirties the page again.
+ */
+static int page_mkclean_one(struct page *page, struct vm_area_struct *vma)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long address;
+	pte_t *pte, entry;
+	spinlock_t *ptl;
+	int ret = 0;
+
+	address = vma_address(page, vma);
+	if (address == -EFAULT)
+		goto out;
+
+	pte = page_check_address(page, mm, address, &ptl);
+	if (!pte)
+		goto out;
+
+	if (pte_dirty(*pte) || pte_write(*pte)) {
+		flush_cache_page(vma, address, pte_pfn(*pte));
+		entry = ptep_clear_flush(vma, address, pte);
+		entry = pte_wrprotect(entry);
+		entry = pte_mkclean(entry);
+		set_pte_at(mm, address, pte, entry);
+		lazy_mmu_prot_update(entry);
+		ret = 1;
+	}
+
+	pte_unmap_unlock(pte, ptl);
+out:
+	return ret;
+}
+
+/*
+ * Only the shared mappings can dirty the page behind our back; private ones
+ * have their own copy by the time they write.  Nonlinear vmas are left
+ * alone: they are not in the prio tree, and are never write-protected by
+ * vma_wants_writenotify() in the first place.
+ */
+static int page_mkclean_file(struct address_space *mapping, struct page *page)
+{
+	pgoff_t pgoff = page->index << (PAGE_CACHE_SHIFT - PAGE_SHIFT);
+	struct vm_area_struct *vma;
+	struct prio_tree_iter iter;
+	int ret = 0;
+
+	BUG_ON(PageAnon(page));
+
+	spin_lock(&mapping->i_mmap_lock);
+	vma_prio_tree_foreach(vma, &iter, &mapping->i_mmap, pgoff, pgoff) {
+		if (vma->vm_flags & VM_SHARED)
+			ret += page_mkclean_one(page, vma);
+	}
+	spin_unlock(&mapping->i_mmap_lock);
+	return ret;
+}
+
+/**
+ * page_mkclean - write-protect all shared mappings of a page
+ * @page: the page to clean, locked by the caller
+ *
+ * Called before a page is written back, so that the next store through a
+ * shared writable mapping faults and goes through dirty accounting again.
+ * Returns nonzero if any of the ptes was dirty or writable: the caller must
+ * then treat the page as dirty.
+ */
+int page_mkclean(struct page *page)
+{
+	int ret = 0;
+
+	BUG_ON(!PageLocked(page));
+
+	if (page_mapped(page)) {
+		struct address_space *mapping = page_mapping(page);
+		if (mapping)
+			ret = page_mkclean_file(mapping, page);
+		if (page_test_and_clear_dirty(page))
+			ret = 1;
+	}
+
+	return ret;
+}
+
 /**
  * page_add_anon_rmap - add pte mapping to an anonymous page
  * @page:	the page to add the mapping to
@@ -476,7 +561,7 @@ void page_add_anon_rmap(struct page *page,
 
 		page->index = linear_page_index(vma, address);
 
-		inc_page_state(nr_mapped);
+		__inc_zone_page_state(page, NR_MAPPED);
 	}
 	/* else checking page index and mapping is racy */
 }
@@ -493,7 +578,7 @@ void page_add_file_rmap(struct page *page)
 	BUG_ON(!pfn_valid(page_to_pfn(page)));
 
 	if (atomic_inc_and_test(&page->_mapcount))
-		inc_page_state(nr_mapped);
+		__inc_zone_page_state(page, NR_MAPPED);
 }
 
 /**
@@ -517,7 +602,7 @@ void page_remove_rmap(struct page *page)
 		 */
 		if (page_test_and_clear_dirty(page))
 			set_page_dirty(page);
-		dec_page_state(nr_mapped);
+		__dec_zone_page_state(page, NR_MAPPED);
 	}
 }
 
@@ -1295,7 +1295,7 @@ static void *kmem_getpages(kmem_cache_t *cachep, gfp_t flags, int nodeid)
 	if (cachep->flags & SLAB_RECLAIM_ACCOUNT)
 		/*记录为可回收的页*/
 		atomic_add(i, &slab_reclaim_pages);
-	add_page_state(nr_slab, i);
+	add_zone_page_state(page_zone(page), NR_SLAB, i);
 	while (i--) {
 		/*将页框标记为PG_slab*/
 		SetPageSlab(page);
@@ -1314,12 +1314,12 @@ static void kmem_freepages(kmem_cache_t *cachep, void *addr)
 	struct page *page = virt_to_page(addr);
 	const unsigned long nr_freed = i;
 
+	sub_zone_page_state(page_zone(page), NR_SLAB, nr_freed);
 	while (i--) {
 		if (!TestClearPageSlab(page))
 			BUG();
 		page++;
 	}
-	sub_page_state(nr_slab, nr_freed);
 	/*如果当前进程正在回收内存*/
 	if (current->reclaim_state)
 		current->reclaim_state->reclaimed_slab += nr_freed;
@@ -3523,6 +3523,8 @@ next:
 	check_irq_on();
 	up(&cache_chain_sem);
 	drain_remote_pages();
+	/* fold this cpu's zone counter differences in every couple of seconds */
+	refresh_cpu_vm_stats(smp_processor_id());
 	/* Setup the next iteration */
 	schedule_delayed_work(&__get_cpu_var(reap_work), REAPTIMEOUT_CPUC + smp_processor_id());
 }
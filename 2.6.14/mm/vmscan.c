@@ -66,7 +66,7 @@ struct scan_control {
 	unsigned long nr_reclaimed;
 
 	/*用户态地址空间引用的页数*/
-	unsigned long nr_mapped;	/* From page_state */
+	unsigned long nr_mapped;	/* From the zone counters */
 
 	/* How many pages shrink_cache() should reclaim */
 	/*待回收的目标页数*/
@@ -281,7 +281,7 @@ static int may_write_to_queue(struct backing_dev_info *bdi)
 {
 	if (current_is_kswapd())
 		return 1;
-	if (current_is_pdflush())	/* This is unlikely, but why not... */
+	if (current_is_flusher())	/* This is unlikely, but why not... */
 		return 1;
 	if (!bdi_write_congested(bdi))
 		return 1;
@@ -1047,10 +1047,10 @@ shrink_caches(struct zone **zones, struct scan_control *sc)
  *
  * If the caller is !__GFP_FS then the probability of a failure is reasonably
  * high - the zone may be full of dirty or under-writeback pages, which this
- * caller can't do much about.  We kick pdflush and take explicit naps in the
- * hope that some of these pages can be written.  But if the allocating task
- * holds filesystem locks which prevent writeout this might not work, and the
- * allocation attempt will fail.
+ * caller can't do much about.  We kick the flushers and take explicit naps in
+ * the hope that some of these pages can be written.  But if the allocating
+ * task holds filesystem locks which prevent writeout this might not work, and
+ * the allocation attempt will fail.
  */
 int try_to_free_pages(struct zone **zones, gfp_t gfp_mask)
 {
@@ -1086,7 +1086,7 @@ int try_to_free_pages(struct zone **zones, gfp_t gfp_mask)
 	 */
 	for (priority = DEF_PRIORITY; priority >= 0; priority--) {
 		/*获取用户态进程的总页数*/
-		sc.nr_mapped = read_page_state(nr_mapped);
+		sc.nr_mapped = global_page_state(NR_MAPPED);
 		sc.nr_scanned = 0;
 		sc.nr_reclaimed = 0;
 		/*设置本次迭代的优先级,优先级越来越高*/
@@ -1117,9 +1117,9 @@ int try_to_free_pages(struct zone **zones, gfp_t gfp_mask)
 		 * that's undesirable in laptop mode, where we *want* lumpy
 		 * writeout.  So in laptop mode, write out the whole world.
 		 */
-		/*如果已经扫描32+32/2都没有达成回收32页的目标，则唤醒pdflush线程,将页高速缓存中的脏页写入磁盘*/
+		/*如果已经扫描32+32/2都没有达成回收32页的目标，则唤醒flusher线程,将页高速缓存中的脏页写入磁盘*/
 		if (total_scanned > sc.swap_cluster_max + sc.swap_cluster_max/2) {
-			wakeup_pdflush(laptop_mode ? 0 : total_scanned);
+			wakeup_flusher_threads(laptop_mode ? 0 : total_scanned);
 			sc.may_writepage = 1;
 		}
 
@@ -1185,7 +1185,7 @@ loop_again:
 	sc.gfp_mask = GFP_KERNEL;
 	sc.may_writepage = 0;
 	sc.may_swap = 1;
-	sc.nr_mapped = read_page_state(nr_mapped);
+	sc.nr_mapped = global_page_state(NR_MAPPED);
 
 	inc_page_state(pageoutrun);
 
@@ -1524,7 +1524,7 @@ int zone_reclaim(struct zone *zone, gfp_t gfp_mask, unsigned int order)
 	sc.gfp_mask = gfp_mask;
 	sc.may_writepage = 0;
 	sc.may_swap = 0;
-	sc.nr_mapped = read_page_state(nr_mapped);
+	sc.nr_mapped = global_page_state(NR_MAPPED);
 	sc.nr_scanned = 0;
 	sc.nr_reclaimed = 0;
 	/* scan at the highest priority */